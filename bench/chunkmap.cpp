@@ -0,0 +1,138 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+#include "chunkmap.h"
+
+/**
+ * Chunk lookup cost under render and pathfinding access patterns:
+ * std::unordered_map vs ChunkMap vs ChunkMap with a last-chunk cursor
+ */
+static inline vec2i getChunkPos(const vec2i& pos) {
+    return vec2i(pos.x & -Chunk::SIZE, pos.y & -Chunk::SIZE);
+}
+
+// visible diamond scan, three layers, as done by World::render
+template <typename Lookup>
+static long render(Lookup lookup, int frames) {
+    long found = 0;
+
+    for (int frame = 0; frame < frames; ++frame) {
+        vec2f lt = vec2f(frame * 0.37f - 300, frame * 0.21f - 300);
+
+        for (int z = 0; z < 3; ++z) {
+            vec2f pos = lt;
+            for (int a = 0; a < 44; ++a) {
+                for (int b = 0; b < 15; ++b) {
+                    found += lookup(vec2i(pos));
+                    pos += vec2f(1, -1);
+                }
+                pos += vec2f(-15, 15);
+                pos += a % 2 ? vec2f(1, 0) : vec2f(0, 1);
+            }
+        }
+    }
+    return found;
+}
+
+// node expansion with 8 neighbours and diagonal corner checks, as done by World::buildPath
+template <typename Lookup>
+static long pathfind(Lookup lookup, int nodes) {
+    static const vec2i steps[] = {{0, -1}, {-1, 0}, {+1, 0}, {0, +1}, {-1, -1}, {+1, -1}, {-1, +1}, {+1, +1}};
+    long found = 0;
+    unsigned rnd = 12345;
+    vec2i cur(-400, -400);
+
+    for (int n = 0; n < nodes; ++n) {
+        for (int i = 0; i < 8; ++i) {
+            found += lookup(cur + steps[i]);
+            if (i > 3) {
+                found += lookup(cur + vec2i(steps[i].x, 0));
+                found += lookup(cur + vec2i(0, steps[i].y));
+            }
+        }
+        // wander like a search frontier, restart searches now and then
+        rnd = rnd * 1103515245 + 12345;
+        cur += steps[(rnd >> 16) % 8];
+        if (n % 64 == 0) {
+            cur = vec2i((rnd >> 8) % 800 - 400, (rnd >> 4) % 800 - 400);
+        }
+    }
+    return found;
+}
+
+template <typename F>
+static void measure(const char* name, F run, long lookups) {
+    auto t0 = std::chrono::steady_clock::now();
+    long found = run();
+    double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::printf("  %-22s %6.2f ns/lookup (%ld passable)\n", name, time * 1e9 / lookups, found);
+}
+
+int main(int argc, char* argv[]) {
+    int radius = argc > 1 ? std::atoi(argv[1]) : 8; // chunks around origin
+
+    Terrain terrain(12345);
+    std::unordered_map<vec2i, std::unique_ptr<Chunk>> hashmap;
+    ChunkMap chunkmap;
+
+    for (int x = -radius; x < radius; ++x) {
+        for (int y = -radius; y < radius; ++y) {
+            vec2i chunk_pos = vec2i(x, y) * Chunk::SIZE;
+            auto a = std::make_unique<Chunk>(), b = std::make_unique<Chunk>();
+            terrain.generate(*a, chunk_pos);
+            *b = *a;
+            hashmap[chunk_pos] = std::move(a);
+            chunkmap.insert(chunk_pos, std::move(b));
+        }
+    }
+
+    auto viaHashmap = [&hashmap](const vec2i& pos) {
+        vec2i chunk_pos = getChunkPos(pos);
+        auto it = hashmap.find(chunk_pos);
+        return it != hashmap.end() && it->second->isPassable(pos - chunk_pos);
+    };
+    auto viaChunkmap = [&chunkmap](const vec2i& pos) {
+        vec2i chunk_pos = getChunkPos(pos);
+        const Chunk* chunk = chunkmap.find(chunk_pos);
+        return chunk && chunk->isPassable(pos - chunk_pos);
+    };
+    ChunkMap::Cursor cursor;
+    auto viaCursor = [&chunkmap, &cursor](const vec2i& pos) {
+        vec2i chunk_pos = getChunkPos(pos);
+        const Chunk* chunk = chunkmap.find(chunk_pos, cursor);
+        return chunk && chunk->isPassable(pos - chunk_pos);
+    };
+
+    const int frames = 2000, nodes = 200000;
+    const long render_lookups = long(frames) * 3 * 44 * 15, path_lookups = long(nodes) * 16;
+
+    std::printf("%zu chunks resident\n", chunkmap.size());
+    std::printf("render pattern:\n");
+    measure("std::unordered_map", [&]() { return render(viaHashmap, frames); }, render_lookups);
+    measure("ChunkMap", [&]() { return render(viaChunkmap, frames); }, render_lookups);
+    measure("ChunkMap + cursor", [&]() { return render(viaCursor, frames); }, render_lookups);
+    std::printf("pathfinding pattern:\n");
+    measure("std::unordered_map", [&]() { return pathfind(viaHashmap, nodes); }, path_lookups);
+    measure("ChunkMap", [&]() { return pathfind(viaChunkmap, nodes); }, path_lookups);
+    measure("ChunkMap + cursor", [&]() { return pathfind(viaCursor, nodes); }, path_lookups);
+
+    return 0;
+}
@@ -0,0 +1,127 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "spatialgrid.h"
+
+/**
+ * Contact tests per tick, all pairs scan vs uniform grid broadphase,
+ * with object counts from 10 to 10000 at a constant density
+ */
+struct Body {
+    vec2f m_pos;
+    vec2f m_vel;
+};
+
+// the grid only stores handles, bodies are addressed by index
+static inline Object* handle(size_t i) {
+    return reinterpret_cast<Object*>(uintptr_t(i + 1));
+}
+
+static inline size_t index(Object* object) {
+    return reinterpret_cast<uintptr_t>(object) - 1;
+}
+
+static void move(std::vector<Body>& bodies, float side, float dt) {
+    for (auto& body : bodies) {
+        body.m_pos += body.m_vel * dt;
+        if (body.m_pos.x < 0 || body.m_pos.x > side) body.m_vel.x = -body.m_vel.x;
+        if (body.m_pos.y < 0 || body.m_pos.y > side) body.m_vel.y = -body.m_vel.y;
+    }
+}
+
+static long brute(std::vector<Body> bodies, float side, int ticks) {
+    long contacts = 0;
+
+    for (int tick = 0; tick < ticks; ++tick) {
+        move(bodies, side, 0.02f);
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            for (size_t j = 0; j < bodies.size(); ++j) {
+                if (i != j && (bodies[i].m_pos - bodies[j].m_pos).squareLength() <= 0.5) {
+                    contacts++;
+                }
+            }
+        }
+    }
+    return contacts;
+}
+
+static long grid(std::vector<Body> bodies, float side, int ticks) {
+    SpatialGrid grid(1.0f);
+    long contacts = 0;
+
+    for (int tick = 0; tick < ticks; ++tick) {
+        grid.clear();
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            grid.insert(handle(i), bodies[i].m_pos);
+        }
+        for (auto& body : bodies) {
+            vec2f pos = body.m_pos;
+            body.m_pos += body.m_vel * 0.02f;
+            if (body.m_pos.x < 0 || body.m_pos.x > side) body.m_vel.x = -body.m_vel.x;
+            if (body.m_pos.y < 0 || body.m_pos.y > side) body.m_vel.y = -body.m_vel.y;
+            grid.move(handle(&body - bodies.data()), pos, body.m_pos);
+        }
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            grid.forEachNear(bodies[i].m_pos, 0.7072f, [&](Object* other) {
+                size_t j = index(other);
+                if (i != j && (bodies[i].m_pos - bodies[j].m_pos).squareLength() <= 0.5) {
+                    contacts++;
+                }
+            });
+        }
+    }
+    return contacts;
+}
+
+template <typename F>
+static double measure(F run, long& contacts) {
+    auto t0 = std::chrono::steady_clock::now();
+    contacts = run();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main() {
+    unsigned rnd = 12345;
+    auto random = [&rnd]() {
+        rnd = rnd * 1103515245 + 12345;
+        return ((rnd >> 8) & 0xffff) / 65536.0f;
+    };
+
+    std::printf("%8s %14s %14s %10s\n", "objects", "all pairs", "grid", "contacts");
+    for (int count : {10, 100, 1000, 10000}) {
+        // about one object per 4 tiles, like a crowded battle
+        float side = std::sqrt(count * 4.0f);
+        std::vector<Body> bodies(count);
+
+        for (auto& body : bodies) {
+            body.m_pos = vec2f(random() * side, random() * side);
+            body.m_vel = vec2f(random() * 8 - 4, random() * 8 - 4);
+        }
+
+        int ticks = count > 1000 ? 10 : 100;
+        long a, b;
+        double ta = measure([&]() { return brute(bodies, side, ticks); }, a);
+        double tb = measure([&]() { return grid(bodies, side, ticks); }, b);
+
+        std::printf("%8d %11.3f ms %11.3f ms %10ld%s\n", count, ta * 1e3 / ticks, tb * 1e3 / ticks, b / ticks, a == b ? "" : " MISMATCH");
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include "pathfinder.h"
+
+/**
+ * Path searches on a map with scattered rocks, A* on a hash map of nodes
+ * allocated per search vs Pathfinder, both limited to the same number of
+ * expanded nodes, for goals from 8 to 64 tiles away
+ */
+static inline bool passable(const vec2i& pos) {
+    uint32_t h = uint32_t(pos.x) * 0x9e3779b1u ^ uint32_t(pos.y) * 0x85ebca6bu;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    return (h & 0xff) > 64; // a quarter of the tiles are blocked
+}
+
+static inline int octile(const vec2i& v) {
+    int dx = std::abs(v.x), dy = std::abs(v.y);
+    return (dx > dy) ? (1000 * dx + 414 * dy) : (1000 * dy + 414 * dx);
+}
+
+static bool hashed(const vec2i& start, const vec2i& goal, unsigned budget, std::vector<vec2f>& path) {
+    static const vec2i steps[] = {{0, -1}, {-1, 0}, {+1, 0}, {0, +1}, {-1, -1}, {+1, -1}, {-1, +1}, {+1, +1}};
+    static const int weights[] = {1000, 1000, 1000, 1000, 1414, 1414, 1414, 1414};
+
+    struct Node {
+        Node(): actual(std::numeric_limits<int>::max()), closed(false) {}
+        Node* parent;
+        vec2i idx;
+        int   actual;
+        bool  closed;
+    };
+    typedef std::pair<int, Node*> Entry;
+
+    std::unordered_map<vec2i, Node> nodes;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+
+    Node* cur = &nodes[start];
+    cur->idx = start;
+    cur->parent = nullptr;
+    cur->actual = 0;
+    Node* best = cur;
+    queue.push(Entry(octile(start - goal), cur));
+
+    for (unsigned expanded = 0; !queue.empty() && expanded < budget; ) {
+        cur = queue.top().second;
+        queue.pop();
+        if (cur->closed) {
+            continue;
+        }
+        cur->closed = true;
+        expanded++;
+
+        if (cur->idx == goal) {
+            best = cur;
+            break;
+        }
+        if (octile(cur->idx - goal) < octile(best->idx - goal)) {
+            best = cur;
+        }
+        for (int i = 0; i < 8; ++i) {
+            vec2i idx = cur->idx + steps[i];
+            if (!passable(idx) || (i > 3 && (!passable(cur->idx + vec2i(steps[i].x, 0)) || !passable(cur->idx + vec2i(0, steps[i].y))))) {
+                continue;
+            }
+            Node* next = &nodes[idx];
+            int actual = cur->actual + weights[i];
+            if (!next->closed && actual < next->actual) {
+                next->idx = idx;
+                next->parent = cur;
+                next->actual = actual;
+                queue.push(Entry(actual + octile(idx - goal), next));
+            }
+        }
+    }
+
+    path.clear();
+    for (cur = best; cur && cur->idx != start; cur = cur->parent) {
+        path.push_back((vec2f)cur->idx);
+    }
+    return best->idx == goal;
+}
+
+int main() {
+    const unsigned budget = Pathfinder::BUDGET;
+    const int searches = 2000;
+    unsigned rnd = 12345;
+    auto random = [&rnd](int n) {
+        rnd = rnd * 1103515245 + 12345;
+        return int((rnd >> 8) % unsigned(n));
+    };
+
+    Pathfinder pathfinder(budget);
+    std::vector<vec2f> path;
+
+    std::printf("%8s %14s %14s %16s %8s\n", "distance", "hash map", "flat grid", "reached", "nodes");
+    for (int distance : {8, 16, 32, 64}) {
+        std::vector<std::pair<vec2i, vec2i>> queries;
+        while ((int)queries.size() < searches) {
+            vec2i start(random(4096), random(4096));
+            vec2i goal = start + vec2i(random(2 * distance + 1) - distance, distance * (random(2) ? 1 : -1));
+            if (passable(start) && passable(goal)) {
+                queries.emplace_back(start, goal);
+            }
+        }
+
+        int ra = 0, rb = 0;
+        unsigned long expanded = pathfinder.getStats().m_expanded;
+        auto t0 = std::chrono::steady_clock::now();
+        for (auto& query : queries) {
+            ra += hashed(query.first, query.second, budget, path);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        for (auto& query : queries) {
+            rb += pathfinder.find(query.first, query.second, passable, path);
+        }
+        auto t2 = std::chrono::steady_clock::now();
+
+        double ta = std::chrono::duration<double, std::micro>(t1 - t0).count() / searches;
+        double tb = std::chrono::duration<double, std::micro>(t2 - t1).count() / searches;
+        expanded = pathfinder.getStats().m_expanded - expanded;
+        std::printf("%8d %11.2f us %11.2f us %7d / %-7d %8lu\n", distance, ta, tb, ra, rb, expanded / searches);
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "pathfinder.h"
+#include "routeplanner.h"
+#include "terrain.h"
+
+/**
+ * Long walks on generated terrain: time to build chunk graphs, then route
+ * searches over them alone and with every step of the route walked by
+ * Pathfinder searches, for goals from 64 to 512 tiles away
+ */
+int main() {
+    const int radius = 6; // chunks around the origin
+    const int searches = 1000;
+    unsigned rnd = 12345;
+    auto random = [&rnd](int n) {
+        rnd = rnd * 1103515245 + 12345;
+        return int((rnd >> 8) % unsigned(n));
+    };
+
+    Terrain terrain(42);
+    std::unordered_map<vec2i, std::unique_ptr<Chunk>> chunks;
+    size_t entrances = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int x = -radius; x < radius; ++x) {
+        for (int y = -radius; y < radius; ++y) {
+            vec2i chunk_pos = vec2i(x, y) * Chunk::SIZE;
+            auto chunk = std::make_unique<Chunk>();
+            terrain.generate(*chunk, chunk_pos);
+            chunk->m_graph.build(*chunk, chunk_pos, terrain);
+            entrances += chunk->m_graph.size();
+            chunks[chunk_pos] = std::move(chunk);
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    std::printf("%zu chunks, %.2f ms per chunk, %.1f entrances\n", chunks.size(),
+        std::chrono::duration<double, std::milli>(t1 - t0).count() / chunks.size(), double(entrances) / chunks.size());
+
+    auto graphs = [&chunks](const vec2i& chunk_pos) -> const ChunkGraph* {
+        auto it = chunks.find(chunk_pos);
+        return it != chunks.end() ? &it->second->m_graph : nullptr;
+    };
+    auto passable = [&chunks](const vec2i& pos) {
+        vec2i chunk_pos(pos.x & -Chunk::SIZE, pos.y & -Chunk::SIZE);
+        auto it = chunks.find(chunk_pos);
+        return it != chunks.end() && it->second->isPassable(pos - chunk_pos);
+    };
+
+    RoutePlanner planner;
+    Pathfinder pathfinder;
+    std::vector<vec2f> route, path;
+
+    std::printf("%8s %14s %14s %16s %8s\n", "distance", "route", "with paths", "routed / walked", "nodes");
+    for (int distance : {64, 128, 256, 512}) {
+        std::vector<std::pair<vec2i, vec2i>> queries;
+        while ((int)queries.size() < searches) {
+            int side = radius * Chunk::SIZE;
+            vec2i start(random(2 * side) - side, random(2 * side) - side);
+            vec2i goal = start + vec2i(random(2 * distance + 1) - distance, distance * (random(2) ? 1 : -1));
+            if (passable(start) && passable(goal)) {
+                queries.emplace_back(start, goal);
+            }
+        }
+
+        int routed = 0, walked = 0;
+        unsigned long expanded = planner.getStats().m_expanded;
+        auto t0 = std::chrono::steady_clock::now();
+        for (auto& query : queries) {
+            routed += planner.find(query.first, query.second, graphs, route);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        for (auto& query : queries) {
+            if (!planner.find(query.first, query.second, graphs, route)) {
+                continue;
+            }
+            // as characters do, a path out of the budget is walked and searched on from its end
+            for (vec2i pos = query.first; !route.empty(); ) {
+                bool reached = pathfinder.find(pos, route.back().round<int>(), passable, path);
+                if (!path.empty()) {
+                    pos = path.front().round<int>();
+                }
+                if (reached) {
+                    route.pop_back();
+                }
+                else if (path.empty()) {
+                    break;
+                }
+            }
+            walked += route.empty();
+        }
+        auto t2 = std::chrono::steady_clock::now();
+
+        double ta = std::chrono::duration<double, std::micro>(t1 - t0).count() / searches;
+        double tb = std::chrono::duration<double, std::micro>(t2 - t1).count() / searches;
+        expanded = planner.getStats().m_expanded - expanded;
+        std::printf("%8d %11.2f us %11.2f us %7d / %-7d %8lu\n", distance, ta, tb, routed, walked, expanded / (2 * searches));
+    }
+    return 0;
+}
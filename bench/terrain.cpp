@@ -0,0 +1,88 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include "terrain.h"
+
+/**
+ * Chunk generation throughput: per tile reference vs whole chunk heightfield
+ * with each supported hashing kernel
+ */
+int main(int argc, char* argv[]) {
+    static const char* names[] = {"scalar", "sse2"};
+
+    int seed   = argc > 1 ? std::atoi(argv[1]) : 12345;
+    int chunks = argc > 2 ? std::atoi(argv[2]) : 64;
+
+    Terrain terrain(seed);
+    auto reference = std::make_unique<Chunk>();
+    auto chunk = std::make_unique<Chunk>();
+    double tiles = double(chunks) * Chunk::SIZE * Chunk::SIZE;
+    int mismatches = 0;
+
+    std::printf("seed %d, %d chunks of %d bytes\n", seed, chunks, (int)sizeof(Chunk));
+
+    // walk a grid of chunks, including the flat center and negative coords
+    auto chunkPos = [](int i) {
+        return vec2i(i % 8 - 4, i / 8 - 4) * Chunk::SIZE;
+    };
+
+    // per tile reference, including passability bitmap
+    auto generate = [&terrain](Chunk& chunk, const vec2i& chunk_pos) {
+        for (int x = 0; x < Chunk::SIZE; ++x) {
+            chunk.m_passable[x] = 0;
+            for (int y = 0; y < Chunk::SIZE; ++y) {
+                if (terrain.generate(chunk.m_tiles[x][y], chunk_pos + vec2i(x, y))) {
+                    chunk.m_passable[x] |= uint64_t(1) << y;
+                }
+            }
+        }
+    };
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < chunks; ++i) {
+        generate(*reference, chunkPos(i));
+    }
+    double reference_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::printf("per tile:       %12.0f tiles/s\n", tiles / reference_time);
+
+    for (int kernel = Terrain::KERNEL_SCALAR; kernel <= Terrain::KERNEL_SSE2; ++kernel) {
+        if (!Terrain::setKernel(Terrain::Kernel(kernel))) {
+            continue;
+        }
+
+        double time = 0;
+        for (int i = 0; i < chunks; ++i) {
+            auto t1 = std::chrono::steady_clock::now();
+            terrain.generate(*chunk, chunkPos(i));
+            time += std::chrono::duration<double>(std::chrono::steady_clock::now() - t1).count();
+
+            generate(*reference, chunkPos(i));
+            if (std::memcmp(reference->m_tiles, chunk->m_tiles, sizeof(chunk->m_tiles)) != 0 ||
+                std::memcmp(reference->m_passable, chunk->m_passable, sizeof(chunk->m_passable)) != 0) {
+                mismatches++;
+            }
+        }
+        std::printf("chunk (%-6s): %12.0f tiles/s (x%.1f)\n", names[kernel], tiles / time, reference_time / time);
+    }
+    std::printf("mismatched chunks: %d\n", mismatches);
+
+    return mismatches ? 1 : 0;
+}
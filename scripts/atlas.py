@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+
+# Winter-Strike Game
+# Copyright (C) 2019 Boris Kumok
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+"""
+Pack sprite sheets into atlas pages.
+
+Every sheet is copied as a whole, so frames keep their layout and the game
+only needs the sheet origin on the page. Writes atlas-<n>.png pages and
+atlas.txt with one "<sheet> <page> <x> <y> <w> <h>" line per sheet.
+Pages stay within 2048 pixels, which every GPU can load as one texture.
+Larger sheets are left out and the game loads them from their own files.
+
+Only plain python is used (8-bit RGB/RGBA non-interlaced PNG).
+"""
+
+import argparse
+import os.path
+import struct
+import zlib
+
+PNG_SIGNATURE = b'\x89PNG\r\n\x1a\n'
+
+
+def paeth(a, b, c):
+    p = a + b - c
+    pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+    if pa <= pb and pa <= pc:
+        return a
+    return b if pb <= pc else c
+
+
+def read_png(filename):
+    with open(filename, 'rb') as f:
+        data = f.read()
+
+    if data[:8] != PNG_SIGNATURE:
+        raise ValueError('%s: not a PNG file' % filename)
+
+    pos, idat = 8, []
+    while pos < len(data):
+        length, tag = struct.unpack('>I4s', data[pos:pos + 8])
+        chunk = data[pos + 8:pos + 8 + length]
+        if tag == b'IHDR':
+            width, height, depth, color, _, _, interlace = struct.unpack('>IIBBBBB', chunk)
+        elif tag == b'IDAT':
+            idat.append(chunk)
+        pos += 12 + length
+
+    if depth != 8 or color not in (2, 6) or interlace != 0:
+        raise ValueError('%s: only 8-bit non-interlaced RGB/RGBA is supported' % filename)
+
+    raw = zlib.decompress(b''.join(idat))
+    bpp = 4 if color == 6 else 3
+    stride = width * bpp
+    prev = bytearray(stride)
+    rows = []
+
+    for y in range(height):
+        start = y * (stride + 1)
+        kind, line = raw[start], bytearray(raw[start + 1:start + 1 + stride])
+
+        if kind == 1:
+            for i in range(bpp, stride):
+                line[i] = (line[i] + line[i - bpp]) & 0xff
+        elif kind == 2:
+            line = bytearray(map(lambda x, b: (x + b) & 0xff, line, prev))
+        elif kind == 3:
+            for i in range(stride):
+                a = line[i - bpp] if i >= bpp else 0
+                line[i] = (line[i] + ((a + prev[i]) >> 1)) & 0xff
+        elif kind == 4:
+            for i in range(stride):
+                a, c = (line[i - bpp], prev[i - bpp]) if i >= bpp else (0, 0)
+                line[i] = (line[i] + paeth(a, prev[i], c)) & 0xff
+
+        if bpp == 3:
+            rgba = bytearray(width * 4)
+            for i in range(3):
+                rgba[i::4] = line[i::3]
+            rgba[3::4] = b'\xff' * width
+            rows.append(rgba)
+        else:
+            rows.append(line)
+        prev = line
+
+    return width, height, rows
+
+
+def write_png(filename, width, height, pixels):
+    def chunk(tag, body):
+        return struct.pack('>I', len(body)) + tag + body + struct.pack('>I', zlib.crc32(tag + body))
+
+    stride = width * 4
+    raw = b''.join(b'\x00' + bytes(pixels[y * stride:(y + 1) * stride]) for y in range(height))
+
+    with open(filename, 'wb') as f:
+        f.write(PNG_SIGNATURE)
+        f.write(chunk(b'IHDR', struct.pack('>IIBBBBB', width, height, 8, 6, 0, 0, 0)))
+        f.write(chunk(b'IDAT', zlib.compress(raw, 9)))
+        f.write(chunk(b'IEND', b''))
+
+
+def pack(sheets, max_size, padding):
+    """Shelf packing, tallest sheets first. Returns pages of placed sheets."""
+    pages, page, shelf_y, shelf_h, x = [], [], 0, 0, 0
+
+    for sheet in sorted(sheets, key=lambda s: (-s['h'], -s['w'])):
+        w, h = sheet['w'], sheet['h']
+        if w > max_size or h > max_size:
+            print('%s: %dx%d does not fit %d page, not packed' % (sheet['name'], w, h, max_size))
+            continue
+
+        if x + w > max_size:
+            shelf_y, shelf_h, x = shelf_y + shelf_h + padding, 0, 0
+        if shelf_y + h > max_size:
+            pages.append(page)
+            page, shelf_y, shelf_h, x = [], 0, 0, 0
+
+        sheet['x'], sheet['y'] = x, shelf_y
+        page.append(sheet)
+        x += w + padding
+        shelf_h = max(shelf_h, h)
+
+    if page:
+        pages.append(page)
+    return pages
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Pack sprite sheets into atlas pages')
+    parser.add_argument('-o', '--output', required=True, help='output directory')
+    parser.add_argument('-m', '--max-size', type=int, default=2048, help='max page width and height')
+    parser.add_argument('-p', '--padding', type=int, default=2, help='transparent gap between sheets')
+    parser.add_argument('sheets', nargs='+', help='sprite sheet PNG files')
+    args = parser.parse_args()
+
+    sheets = []
+    for filename in args.sheets:
+        w, h, rows = read_png(filename)
+        sheets.append({'name': os.path.basename(filename), 'w': w, 'h': h, 'rows': rows})
+
+    os.makedirs(args.output, exist_ok=True)
+    table = []
+
+    for n, page in enumerate(pack(sheets, args.max_size, args.padding)):
+        name = 'atlas-%d.png' % n
+        width = max(s['x'] + s['w'] for s in page)
+        height = max(s['y'] + s['h'] for s in page)
+        pixels = bytearray(width * height * 4)
+
+        for s in page:
+            for y, row in enumerate(s['rows']):
+                offset = ((s['y'] + y) * width + s['x']) * 4
+                pixels[offset:offset + len(row)] = row
+            table.append('%s %s %d %d %d %d' % (s['name'], name, s['x'], s['y'], s['w'], s['h']))
+
+        write_png(os.path.join(args.output, name), width, height, pixels)
+        print('%s: %dx%d, %d sheets' % (name, width, height, len(page)))
+
+    with open(os.path.join(args.output, 'atlas.txt'), 'w') as f:
+        f.write('\n'.join(sorted(table)) + '\n')
+
+
+if __name__ == '__main__':
+    main()
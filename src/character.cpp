@@ -15,44 +15,34 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <SDL.h>
-#include <algorithm> // random_shuffle
+#include <algorithm> // shuffle
+#include "game.h"
 #include "sprite.h"
 #include "world.h"
 #include "character.h"
-#include "snowball.h"
-#include "label.h"
 
 Character::Character(World& world, const vec2f& pos, bool ai) :
-    Object(world, ai ? "CharacterAI" : "Character", pos),
+    Object(world, ai ? "CharacterAI" : "Character", TYPE_CHARACTER | (ai ? TYPE_AI : TYPE_PLAYER), pos),
     m_dir(1, 0),
     m_facing(getFacing(m_dir)),
-    m_state(IDLE),
-    m_frame(0),
+    m_state(-1),
     m_hp(100),
-    m_ai(ai)
+    m_ai(ai),
+    m_sprites(world.getGame().getSprites(ai ? Game::SPRITE_CHARACTER_BLUE : Game::SPRITE_CHARACTER_RED)),
+    m_random(world.getRandom().fork())
 {
-    std::string file = std::string("character-") + (m_ai ? "blue" : "red") + ".png";
-
-    m_sprites.resize(7);
-    m_sprites[IDLE  ].load(m_world.getGame(), file, vec2i(128, 128), vec2i(64, 94), 8, 1);
-    m_sprites[WALK  ].load(m_world.getGame(), file, vec2i(128, 128), vec2i(64, 94), 0, 8);
-    m_sprites[THROW1].load(m_world.getGame(), file, vec2i(128, 128), vec2i(64, 94), 8, 5);
-    m_sprites[THROW2].load(m_world.getGame(), file, vec2i(128, 128), vec2i(64, 94), 13, 3);
-    m_sprites[HIT   ].load(m_world.getGame(), file, vec2i(128, 128), vec2i(64, 94), 16, 8);
-    m_sprites[DIE   ].load(m_world.getGame(), file, vec2i(128, 128), vec2i(64, 94), 24, 8);
-    m_sprites[DEAD  ].load(m_world.getGame(), file, vec2i(128, 128), vec2i(64, 94), 31, 1);
+    setState(IDLE);
 }
 
 void Character::render(SDL_Renderer* renderer, const vec2i& pos) {
-    m_sprites[m_state].render(renderer, pos, m_facing, m_frame);
+    m_sprites[m_state].render(renderer, pos, m_facing, getFrame());
 }
 
 void Character::update(float dt) {
-    // animate
-    m_frame += 8 * dt;
-    if (m_frame >= m_sprites[m_state].getFrames()) {
+    // one-shot animations are over, looped ones start over by themselves
+    if (checkState(Entities::STOPPED)) {
         if (m_state == THROW1) {
-            m_world.add(std::make_unique<Snowball>(m_world, m_pos, m_dir, m_object_id));
+            m_world.addSnowball(getPosition(), m_dir, m_object_id);
             setState(THROW2);
         }
         else if (m_state == THROW2) {
@@ -63,25 +53,22 @@ void Character::update(float dt) {
         }
         else if (m_state == DIE) {
             setState(DEAD);
-            m_z = 1;
+            setZ(1);
+            setType(TYPE_CORPSE);
             m_classname = "Corpse";
 
             if (!m_ai) {
-                m_world.add(std::make_unique<Label>(m_world, m_pos, std::string("Game over"), 96, 0x804040ff, 5));
+                m_world.addLabel(getPosition(), "Game over", 96, 0x804040ff, 5);
             }
         }
-        else {
-            m_frame = 0; // loop
-        }
     }
 
-    // update character position
+    // moved by the motion system while walking
     if (m_state == WALK) {
-        m_pos += m_dir * 4 * dt;
-
         // check next waypoint
-        if (!m_path.empty() && (m_path.back() - m_pos).length() < .1) {
+        if (!m_path.empty() && (m_path.back() - getPosition()).length() < .1) {
             m_path.pop_back();
+            followRoute();
 
             if (m_path.empty()) {
                 setState(IDLE);
@@ -93,43 +80,42 @@ void Character::update(float dt) {
     }
 
    // idle AIs might do something
-   if (m_ai && m_state == IDLE && std::rand() < RAND_MAX / 64) {
+   if (m_ai && m_state == IDLE && m_random.below(64) == 0) {
        bool attack = false;
    
        // attack someone
-       if (std::rand() % 4) {
-           std::vector<Object*> objects(m_world.getObjectsInRadius(m_pos, 16));
-           std::random_shuffle(objects.begin(), objects.end());
+       auto enemy = [this](const Object* object) {
+           return object->isType(TYPE_PLAYER) && object != this;
+       };
+
+       if (m_random.below(4)) {
+           m_nearby.clear();
+           m_world.queryRadius(getPosition(), 16, m_nearby, enemy);
+           std::shuffle(m_nearby.begin(), m_nearby.end(), m_random);
    
            // find someone we can attack
-           for (auto object : objects) {
-               if (object != this && object->getClassname() == "Character") {
-                   // check if target is reachable
-                   if (m_world.checkVisible(m_pos, object->getPosition())) {
-                       throwAt(object->getPosition());
-                       attack = true;
-                       break;
-                   }
+           for (auto object : m_nearby) {
+               // check if target is reachable
+               if (m_world.checkVisible(getPosition(), object->getPosition())) {
+                   throwAt(object->getPosition());
+                   attack = true;
+                   break;
                }
            }
        }
    
        // or try to move closer
        if (!attack) {
-           std::vector<Object*> objects(m_world.getObjectsInRadius(m_pos, 64));
-           std::random_shuffle(objects.begin(), objects.end());
-           Object* object = this;
-   
-           for (auto other : objects) {
-               if (other != this && other->getClassname() == "Character") {
-                   object = other;
-                   break;
-               }
-           }
+           m_nearby.clear();
+           m_world.queryRadius(getPosition(), 64, m_nearby, enemy);
+           std::shuffle(m_nearby.begin(), m_nearby.end(), m_random);
+           Object* object = m_nearby.empty() ? this : m_nearby.front();
    
            // find open spot
            for (int i = 0; i < 10; i++) {
-               vec2f dst = object->getPosition() + vec2f(std::rand() % 6 - 3, std::rand() % 6 - 3);
+               int dx = int(m_random.below(6)) - 3;
+               int dy = int(m_random.below(6)) - 3;
+               vec2f dst = object->getPosition() + vec2f(dx, dy);
                if (m_world.isPassable((vec2i)dst)) {
                    walkTo(dst);
                    break;
@@ -141,8 +127,11 @@ void Character::update(float dt) {
 
 void Character::setState(int state) {
     if (m_state != state) {
+        bool loop = state == IDLE || state == WALK || state == DEAD;
+
         m_state = state;
-        m_frame = 0;
+        setAnimation(loop ? Entities::ANIM_LOOP : Entities::ANIM_ONCE, m_sprites[state].getFrames(), 8);
+        setVelocity(state == WALK ? m_dir * 4 : vec2f());
     }
 }
 
@@ -170,9 +159,13 @@ int Character::getFacing(const vec2f& dir) {
 }
 
 void Character::lookAt(const vec2f& pos) {
-    m_dir = pos - m_pos;
+    m_dir = pos - getPosition();
     m_dir.normalize();
     m_facing = getFacing(m_dir);
+
+    if (m_state == WALK) {
+        setVelocity(m_dir * 4);
+    }
 }
 
 void Character::throwAt(const vec2f& pos) {
@@ -184,7 +177,9 @@ void Character::throwAt(const vec2f& pos) {
 
 void Character::walkTo(const vec2f& pos) {
     if (m_state == IDLE || m_state == WALK || m_state == THROW1) {
-        m_path = m_world.buildPath(m_pos, pos);
+        m_world.buildRoute(getPosition(), pos, m_route);
+        m_path.clear();
+        followRoute();
 
         if (!m_path.empty()) {
             lookAt(m_path.back());
@@ -193,6 +188,21 @@ void Character::walkTo(const vec2f& pos) {
     }
 }
 
+/**
+ * Find the path to the next waypoint once the last path is walked.
+ * A waypoint out of the search budget stays, the next path starts closer.
+ */
+void Character::followRoute() {
+    while (m_path.empty() && !m_route.empty()) {
+        if (m_world.buildPath(getPosition(), m_route.back(), m_path)) {
+            m_route.pop_back();
+        }
+        else if (m_path.empty()) {
+            m_route.clear(); // stuck
+        }
+    }
+}
+
 void Character::onCollision(Object* other) {
     if (m_state == WALK) {
         setState(IDLE);
@@ -206,8 +216,7 @@ void Character::onHit(Object* other, int hp) {
     }
     else {
         setState(DIE);
-        m_solid = false;
-        m_collider = false;
+        setFlags(getFlags() & ~(FLAG_SOLID | FLAG_COLLIDER));
     }
-    m_world.add(std::make_unique<Label>(m_world, m_pos, "-" + std::to_string(hp), 16, 0x408040ff));
+    m_world.addLabel(getPosition(), "-" + std::to_string(hp), 16, 0x408040ff);
 } 
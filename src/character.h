@@ -19,6 +19,7 @@
 
 #include <vector>
 #include "object.h"
+#include "random.h"
 #include "sprite.h"
 
 class Character: public Object {
@@ -39,15 +40,18 @@ public:
 private:
     void setState(int state);
     int  getFacing(const vec2f& dir);
+    void followRoute();
 
     vec2f  m_dir;
     int    m_facing;
     int    m_state;
-    float  m_frame;
     int    m_hp;
     bool   m_ai;
 
-    std::vector<vec2f> m_path;
-    std::vector<Sprite> m_sprites;
+    std::vector<vec2f> m_path;  // tiles to the next waypoint of the route
+    std::vector<vec2f> m_route; // waypoints left, each one reached with a new path
+    std::vector<Object*> m_nearby; // query results, reused between decisions
+    const Sprite* m_sprites; // shared, by state
+    Random m_random; // own stream, updates run on any worker
 };
 #endif
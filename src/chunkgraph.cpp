@@ -0,0 +1,218 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include "chunkgraph.h"
+#include "terrain.h"
+
+static_assert(int(ChunkGraph::SIZE) == int(Chunk::SIZE), "graph and chunk sizes differ");
+
+const vec2i ChunkGraph::STEPS[SIDES] = {{0, -1}, {-1, 0}, {+1, 0}, {0, +1}};
+
+ChunkGraph::ChunkGraph() :
+    m_first()
+{
+    std::memset(m_regions, NO_REGION, sizeof(m_regions));
+}
+
+/**
+ * Find entrances and costs between them. The map outside the chunk
+ * is generated tile by tile, so neighbours are not needed.
+ */
+void ChunkGraph::build(const Chunk& chunk, const vec2i& chunk_pos, const Terrain& terrain) {
+    findEntrances(chunk, chunk_pos, terrain);
+    findRegions(chunk);
+    findCosts(chunk);
+}
+
+/**
+ * Split each border into runs of tiles open on both sides
+ */
+void ChunkGraph::findEntrances(const Chunk& chunk, const vec2i& chunk_pos, const Terrain& terrain) {
+    m_entrances.clear();
+
+    for (unsigned side = 0; side < SIDES; ++side) {
+        m_first[side] = m_entrances.size();
+
+        // border tiles of the side, in the same order for the chunk across
+        vec2i first = vec2i(side == 2 ? SIZE - 1 : 0, side == 3 ? SIZE - 1 : 0);
+        vec2i along = (side == 1 || side == 2) ? vec2i(0, 1) : vec2i(1, 0);
+        int run = 0;
+
+        for (int i = 0; i <= SIZE; ++i) {
+            vec2i pos = first + along * i;
+            Tile outside;
+
+            if (i < SIZE && chunk.isPassable(pos) && terrain.generate(outside, chunk_pos + pos + STEPS[side])) {
+                run++;
+                continue;
+            }
+            if (run == 0) {
+                continue;
+            }
+
+            // long runs are entered near both ends, so paths along the border don't detour
+            if (run > LONG_RUN) {
+                m_entrances.push_back({first + along * (i - run), uint8_t(side), NO_REGION});
+                m_entrances.push_back({first + along * (i - 1), uint8_t(side), NO_REGION});
+            }
+            else {
+                m_entrances.push_back({first + along * (i - run + (run - 1) / 2), uint8_t(side), NO_REGION});
+            }
+            run = 0;
+        }
+    }
+    m_first[SIDES] = m_entrances.size();
+}
+
+/**
+ * Flood fill open tiles from each entrance. Diagonal steps need both
+ * straight neighbours open, so straight steps reach the same tiles.
+ */
+void ChunkGraph::findRegions(const Chunk& chunk) {
+    std::memset(m_regions, NO_REGION, sizeof(m_regions));
+
+    std::vector<vec2i> stack;
+    unsigned regions = 0;
+
+    for (auto& entrance : m_entrances) {
+        if (m_regions[entrance.m_pos.x][entrance.m_pos.y] == NO_REGION) {
+            uint8_t region = uint8_t(++regions); // at most 4 * SIZE / 2 entrances
+            m_regions[entrance.m_pos.x][entrance.m_pos.y] = region;
+            stack.push_back(entrance.m_pos);
+
+            while (!stack.empty()) {
+                vec2i pos = stack.back();
+                stack.pop_back();
+
+                for (auto& step : STEPS) {
+                    vec2i next = pos + step;
+                    if (next.x >= 0 && next.y >= 0 && next.x < SIZE && next.y < SIZE &&
+                        m_regions[next.x][next.y] == NO_REGION && chunk.isPassable(next)) {
+                        m_regions[next.x][next.y] = region;
+                        stack.push_back(next);
+                    }
+                }
+            }
+        }
+        entrance.m_region = m_regions[entrance.m_pos.x][entrance.m_pos.y];
+    }
+}
+
+/**
+ * Dijkstra inside the chunk from each entrance to the later ones of its region,
+ * costs are the same both ways. Steps cost 5 straight and 7 diagonal, so the open
+ * list can be a ring of buckets by cost.
+ */
+void ChunkGraph::findCosts(const Chunk& chunk) {
+    static const int dx[] = {0, -1, +1, 0, -1, +1, -1, +1};
+    static const int dy[] = {-1, 0, 0, +1, -1, -1, +1, +1};
+    static const int weights[] = {5, 5, 5, 5, 7, 7, 7, 7};
+    enum { BUCKETS = 8, SCALE = 200 }; // buckets > max step, SCALE * 5 is a straight step of 1000
+    enum { WIDTH = SIZE + 2 };         // tiles with a border, so steps need no bounds checks
+
+    size_t count = m_entrances.size();
+    m_costs.assign(count * count, NO_PATH);
+
+    // allowed steps of each tile, diagonal ones only if adjacent tiles are passable
+    std::vector<uint8_t> steps(WIDTH * WIDTH, 0);
+    int offsets[8];
+    for (int i = 0; i < 8; ++i) {
+        offsets[i] = dx[i] * WIDTH + dy[i];
+    }
+    auto passable = [&chunk](int x, int y) {
+        return x >= 0 && y >= 0 && x < SIZE && y < SIZE && chunk.isPassable(vec2i(x, y));
+    };
+    for (int x = 0; x < SIZE; ++x) {
+        for (int y = 0; y < SIZE; ++y) {
+            uint8_t mask = 0;
+            for (int i = 0; i < 8; ++i) {
+                if (passable(x + dx[i], y + dy[i]) && (i < 4 || (passable(x + dx[i], y) && passable(x, y + dy[i])))) {
+                    mask |= 1 << i;
+                }
+            }
+            steps[(x + 1) * WIDTH + y + 1] = mask;
+        }
+    }
+
+    std::vector<int> costs(WIDTH * WIDTH);
+    std::vector<uint8_t> targets(WIDTH * WIDTH, 0); // entrances still to be reached on a tile
+    std::vector<uint16_t> buckets[BUCKETS];
+    auto getIndex = [](const vec2i& pos) {
+        return (pos.x + 1) * WIDTH + pos.y + 1;
+    };
+
+    for (size_t from = 0; from < count; ++from) {
+        const Entrance& start = m_entrances[from];
+        m_costs[from * count + from] = 0;
+
+        size_t left = 0;
+        for (size_t to = from + 1; to < count; ++to) {
+            if (m_entrances[to].m_region == start.m_region) {
+                targets[getIndex(m_entrances[to].m_pos)]++;
+                left++;
+            }
+        }
+        if (left == 0) {
+            continue;
+        }
+
+        std::fill(costs.begin(), costs.end(), INT_MAX);
+        for (auto& bucket : buckets) {
+            bucket.clear();
+        }
+        costs[getIndex(start.m_pos)] = 0;
+        buckets[0].push_back(uint16_t(getIndex(start.m_pos)));
+        size_t queued = 1;
+
+        for (int cost = 0; queued > 0 && left > 0; ++cost) {
+            std::vector<uint16_t>& bucket = buckets[cost % BUCKETS];
+
+            // steps are shorter than the ring, this bucket gets nothing while it is emptied
+            for (size_t k = 0; k < bucket.size(); ++k) {
+                int index = bucket[k];
+                if (costs[index] != cost) {
+                    continue; // reached cheaper since
+                }
+
+                left -= targets[index];
+                targets[index] = 0;
+
+                for (unsigned mask = steps[index]; mask; mask &= mask - 1) {
+                    int i = __builtin_ctz(mask);
+                    int next = index + offsets[i];
+                    if (cost + weights[i] < costs[next]) {
+                        costs[next] = cost + weights[i];
+                        buckets[costs[next] % BUCKETS].push_back(uint16_t(next));
+                        queued++;
+                    }
+                }
+            }
+            queued -= bucket.size();
+            bucket.clear();
+        }
+
+        for (size_t to = from + 1; to < count; ++to) {
+            if (m_entrances[to].m_region == start.m_region) {
+                int cost = costs[getIndex(m_entrances[to].m_pos)];
+                m_costs[from * count + to] = m_costs[to * count + from] = cost * SCALE;
+                targets[getIndex(m_entrances[to].m_pos)] = 0;
+            }
+        }
+    }
+}
@@ -0,0 +1,88 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef CHUNKGRAPH_H
+#define CHUNKGRAPH_H
+
+#include <cstdint>
+#include <vector>
+#include "vec.h"
+
+struct Chunk;
+class Terrain;
+
+/**
+ * Abstract graph of a chunk for long range path searches. Entrances are
+ * border tiles where the neighbour chunk can be entered, one per run of
+ * open tiles or both ends of a long run. Walking costs between entrances
+ * inside the chunk are found once, when the chunk is generated.
+ * Both chunks of a border place their entrances on it the same way, so
+ * the n-th entrance of a side leads to the n-th of the opposite side.
+ */
+class ChunkGraph {
+public:
+    enum { SIZE = 64 };          // Chunk::SIZE
+    enum { SIDES = 4, LONG_RUN = 16 };
+    enum { NO_REGION = 0, NO_PATH = -1 };
+
+    // sides in the order of straight steps: -y, -x, +x, +y
+    static const vec2i STEPS[SIDES];
+
+    struct Entrance {
+        vec2i   m_pos;    // local coordinates of the tile
+        uint8_t m_side;
+        uint8_t m_region;
+    };
+
+    ChunkGraph();
+
+    void build(const Chunk&, const vec2i& chunk_pos, const Terrain&);
+
+    inline size_t size() const {
+        return m_entrances.size();
+    }
+
+    inline const Entrance& getEntrance(unsigned index) const {
+        return m_entrances[index];
+    }
+
+    // index of the entrance across the border in the graph of the neighbour chunk
+    inline unsigned getCounterpart(unsigned index, const ChunkGraph& across) const {
+        unsigned side = m_entrances[index].m_side;
+        return across.m_first[SIDES - 1 - side] + (index - m_first[side]);
+    }
+
+    // walking cost inside the chunk, 1000 per straight step, NO_PATH if not connected
+    inline int getCost(unsigned from, unsigned to) const {
+        return m_costs[from * m_entrances.size() + to];
+    }
+
+    // tiles of the same region are connected inside the chunk (NO_REGION - no entrance can be reached)
+    inline unsigned getRegion(const vec2i& local_pos) const {
+        return m_regions[local_pos.x][local_pos.y];
+    }
+private:
+    void findEntrances(const Chunk&, const vec2i& chunk_pos, const Terrain&);
+    void findRegions(const Chunk&);
+    void findCosts(const Chunk&);
+
+    std::vector<Entrance> m_entrances;  // by side, in order along the border
+    unsigned              m_first[SIDES + 1]; // first entrance of each side
+    std::vector<int>      m_costs;      // entrances x entrances
+    uint8_t               m_regions[SIZE][SIZE];
+};
+
+#endif
@@ -0,0 +1,120 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "chunkmap.h"
+
+ChunkMap::ChunkMap() :
+    m_slots(16, Slot{vec2i(), nullptr}),
+    m_size(0),
+    m_version(1)
+{
+}
+
+ChunkMap::~ChunkMap() {
+    clear();
+}
+
+/**
+ * Get slot index of the chunk, or of the empty slot where it would go
+ */
+size_t ChunkMap::lookup(const vec2i& chunk_pos) const {
+    size_t mask = m_slots.size() - 1;
+    size_t i = mix(chunk_pos) & mask;
+
+    while (m_slots[i].m_chunk && m_slots[i].m_pos != chunk_pos) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+/**
+ * Find resident chunk, null if not found
+ */
+Chunk* ChunkMap::find(const vec2i& chunk_pos) const {
+    return m_slots[lookup(chunk_pos)].m_chunk;
+}
+
+/**
+ * Add or replace a chunk
+ */
+void ChunkMap::insert(const vec2i& chunk_pos, std::unique_ptr<Chunk> chunk) {
+    if ((m_size + 1) * 2 > m_slots.size()) {
+        rehash(m_slots.size() * 2);
+    }
+
+    Slot& slot = m_slots[lookup(chunk_pos)];
+    if (slot.m_chunk) {
+        delete slot.m_chunk;
+        m_version++;
+    }
+    else {
+        m_size++;
+    }
+    slot.m_pos = chunk_pos;
+    slot.m_chunk = chunk.release();
+}
+
+/**
+ * Remove and free a chunk. Following slots of the probe run are shifted
+ * back, so no tombstones are needed.
+ */
+bool ChunkMap::erase(const vec2i& chunk_pos) {
+    size_t mask = m_slots.size() - 1;
+    size_t i = lookup(chunk_pos);
+
+    if (m_slots[i].m_chunk == nullptr) {
+        return false;
+    }
+    delete m_slots[i].m_chunk;
+    m_slots[i].m_chunk = nullptr;
+    m_size--;
+    m_version++;
+
+    for (size_t j = (i + 1) & mask; m_slots[j].m_chunk; j = (j + 1) & mask) {
+        size_t home = mix(m_slots[j].m_pos) & mask;
+
+        // move the entry into the hole unless its home lies cyclically in (i, j]
+        if ((j > i && (home <= i || home > j)) || (j < i && (home <= i && home > j))) {
+            m_slots[i] = m_slots[j];
+            m_slots[j].m_chunk = nullptr;
+            i = j;
+        }
+    }
+    return true;
+}
+
+/**
+ * Free all chunks
+ */
+void ChunkMap::clear() {
+    for (auto& slot : m_slots) {
+        delete slot.m_chunk;
+        slot.m_chunk = nullptr;
+    }
+    m_size = 0;
+    m_version++;
+}
+
+void ChunkMap::rehash(size_t capacity) {
+    std::vector<Slot> slots(capacity, Slot{vec2i(), nullptr});
+    slots.swap(m_slots);
+
+    for (auto& slot : slots) {
+        if (slot.m_chunk) {
+            m_slots[lookup(slot.m_pos)] = slot;
+        }
+    }
+}
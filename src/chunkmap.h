@@ -0,0 +1,113 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef CHUNKMAP_H
+#define CHUNKMAP_H
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include "terrain.h"
+
+/**
+ * Chunk directory: open addressing with linear probing, keyed by chunk
+ * origin. Owns its chunks, pointers stay valid until the chunk is erased.
+ */
+class ChunkMap {
+public:
+    // Remembers the last two chunks found, so spatially coherent lookups
+    // skip the table. Owned by the caller, reset when any chunk is erased.
+    struct Cursor {
+        vec2i    m_pos[2];
+        Chunk*   m_chunk[2] = {nullptr, nullptr};
+        unsigned m_version = 0;
+    };
+
+    ChunkMap();
+    ~ChunkMap();
+
+    ChunkMap(const ChunkMap&) = delete;
+    ChunkMap& operator=(const ChunkMap&) = delete;
+
+    Chunk* find(const vec2i& chunk_pos) const;
+    void   insert(const vec2i& chunk_pos, std::unique_ptr<Chunk> chunk);
+    bool   erase(const vec2i& chunk_pos);
+    void   clear();
+
+    inline Chunk* find(const vec2i& chunk_pos, Cursor& cursor) const {
+        if (cursor.m_version == m_version) {
+            if (cursor.m_chunk[0] && cursor.m_pos[0] == chunk_pos) {
+                return cursor.m_chunk[0];
+            }
+            if (cursor.m_chunk[1] && cursor.m_pos[1] == chunk_pos) {
+                std::swap(cursor.m_pos[0], cursor.m_pos[1]);
+                std::swap(cursor.m_chunk[0], cursor.m_chunk[1]);
+                return cursor.m_chunk[0];
+            }
+        }
+        else {
+            cursor = Cursor();
+            cursor.m_version = m_version;
+        }
+
+        Chunk* chunk = find(chunk_pos);
+        if (chunk) {
+            cursor.m_pos[1] = cursor.m_pos[0];
+            cursor.m_chunk[1] = cursor.m_chunk[0];
+            cursor.m_pos[0] = chunk_pos;
+            cursor.m_chunk[0] = chunk;
+        }
+        return chunk;
+    }
+
+    inline size_t size() const {
+        return m_size;
+    }
+
+    template <typename F>
+    void forEach(F callback) {
+        for (auto& slot : m_slots) {
+            if (slot.m_chunk) {
+                callback(slot.m_pos, *slot.m_chunk);
+            }
+        }
+    }
+private:
+    struct Slot {
+        vec2i  m_pos;
+        Chunk* m_chunk; // null - empty slot
+    };
+
+    static inline uint64_t mix(const vec2i& chunk_pos) {
+        // murmur3 finalizer over packed chunk indices
+        uint64_t h = uint64_t(uint32_t(chunk_pos.x / Chunk::SIZE)) << 32 | uint32_t(chunk_pos.y / Chunk::SIZE);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    size_t lookup(const vec2i& chunk_pos) const;
+    void   rehash(size_t capacity);
+
+    std::vector<Slot> m_slots; // power of two, at most half full
+    size_t   m_size;
+    unsigned m_version;        // bumped on erase to invalidate cursors
+};
+
+#endif
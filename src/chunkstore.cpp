@@ -0,0 +1,228 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <atomic>
+#include <SDL.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "chunkstore.h"
+
+static const char MAGIC[8] = {'W', 'S', 'C', 'H', 'U', 'N', 'K', 0};
+static const uint32_t VALID = 0x4b4e4843;
+
+ChunkStore::ChunkStore() :
+    m_data(nullptr),
+    m_size(0),
+#ifdef _WIN32
+    m_file(INVALID_HANDLE_VALUE),
+    m_mapping(nullptr),
+#else
+    m_file(-1),
+#endif
+    m_lock(SDL_CreateMutex())
+{
+    if (m_lock == nullptr) {
+        throw std::runtime_error(SDL_GetError());
+    }
+}
+
+ChunkStore::~ChunkStore() {
+    close();
+    SDL_DestroyMutex(m_lock);
+}
+
+/**
+ * Map store file, create or reset it if it does not match the seed or format.
+ * The file is sparse, untouched records take no disk space.
+ */
+bool ChunkStore::open(const std::string& fileName, int seed) {
+    const size_t records = size_t(2 * RADIUS) * size_t(2 * RADIUS);
+
+    close();
+    m_size = HEADER_SIZE + records * sizeof(Record);
+
+#ifdef _WIN32
+    m_file = CreateFileA(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_ERROR, "Chunk store %s: error %lu", fileName.c_str(), GetLastError());
+        return false;
+    }
+    DWORD written;
+    DeviceIoControl(m_file, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &written, nullptr);
+
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, DWORD(uint64_t(m_size) >> 32), DWORD(m_size), nullptr);
+    if (m_mapping) {
+        m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, m_size));
+    }
+#else
+    m_file = ::open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+    if (m_file < 0) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_ERROR, "Chunk store %s: %s", fileName.c_str(), strerror(errno));
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(m_file, &info) == 0 && size_t(info.st_size) != m_size && ftruncate(m_file, m_size) != 0) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_ERROR, "Chunk store %s: %s", fileName.c_str(), strerror(errno));
+        close();
+        return false;
+    }
+
+    void* data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+    m_data = (data == MAP_FAILED) ? nullptr : static_cast<uint8_t*>(data);
+#endif
+
+    if (m_data == nullptr) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_ERROR, "Chunk store %s: can't map file", fileName.c_str());
+        close();
+        return false;
+    }
+
+    Header* header = reinterpret_cast<Header*>(m_data);
+    if (std::memcmp(header->m_magic, MAGIC, sizeof(MAGIC)) != 0 || header->m_version != VERSION ||
+        header->m_seed != seed || header->m_record_size != sizeof(Record) || header->m_radius != RADIUS) {
+        SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Reset chunk store: %s", fileName.c_str());
+
+        // drop stale records
+        for (size_t i = 0; i < records; ++i) {
+            Record* record = reinterpret_cast<Record*>(m_data + HEADER_SIZE) + i;
+            if (record->m_valid) {
+                record->m_valid = 0;
+            }
+        }
+        std::memcpy(header->m_magic, MAGIC, sizeof(MAGIC));
+        header->m_version = VERSION;
+        header->m_seed = seed;
+        header->m_record_size = sizeof(Record);
+        header->m_radius = RADIUS;
+    }
+    header->m_used = std::time(nullptr);
+    return true;
+}
+
+/**
+ * Read the header of a store file without mapping it
+ */
+bool ChunkStore::getInfo(const std::string& fileName, int& seed, int64_t& used) {
+    Header header;
+    FILE* file = std::fopen(fileName.c_str(), "rb");
+
+    if (file == nullptr) {
+        return false;
+    }
+    bool valid = std::fread(&header, sizeof(header), 1, file) == 1 &&
+        std::memcmp(header.m_magic, MAGIC, sizeof(MAGIC)) == 0 && header.m_version == VERSION;
+    std::fclose(file);
+
+    if (valid) {
+        seed = header.m_seed;
+        used = header.m_used;
+    }
+    return valid;
+}
+
+/**
+ * Unmap and close the file, dirty pages are written back by the OS
+ */
+void ChunkStore::close() {
+#ifdef _WIN32
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (m_data) {
+        munmap(m_data, m_size);
+    }
+    if (m_file >= 0) {
+        ::close(m_file);
+        m_file = -1;
+    }
+#endif
+    m_data = nullptr;
+}
+
+/**
+ * Get record of a chunk, null if it's out of the stored area
+ */
+ChunkStore::Record* ChunkStore::getRecord(const vec2i& chunk_pos) const {
+    vec2i index = vec2i(chunk_pos.x / Chunk::SIZE, chunk_pos.y / Chunk::SIZE) + vec2i(RADIUS, RADIUS);
+
+    if (m_data == nullptr || index.x < 0 || index.y < 0 || index.x >= 2 * RADIUS || index.y >= 2 * RADIUS) {
+        return nullptr;
+    }
+    return reinterpret_cast<Record*>(m_data + HEADER_SIZE) + (index.x * 2 * RADIUS + index.y);
+}
+
+/**
+ * Copy stored chunk, false if it was never saved.
+ * Workers load while the main thread saves, possibly the same record
+ * when a chunk was requested twice, so records are copied under the lock.
+ */
+bool ChunkStore::load(const vec2i& chunk_pos, Chunk& chunk) const {
+    const Record* record = getRecord(chunk_pos);
+    bool valid = false;
+
+    SDL_LockMutex(m_lock);
+    if (record && record->m_valid == VALID) {
+        std::memcpy(chunk.m_tiles, record->m_tiles, sizeof(chunk.m_tiles));
+        std::memcpy(chunk.m_passable, record->m_passable, sizeof(chunk.m_passable));
+        valid = true;
+    }
+    SDL_UnlockMutex(m_lock);
+    return valid;
+}
+
+/**
+ * Store a chunk, false if it's out of the stored area.
+ * If the game dies while copying, the record stays invalid. There is no
+ * msync, so after an OS crash or power loss the pages may have reached the
+ * disk in any order and the record may be torn.
+ */
+bool ChunkStore::save(const vec2i& chunk_pos, const Chunk& chunk) {
+    Record* record = getRecord(chunk_pos);
+
+    if (record == nullptr) {
+        return false;
+    }
+    SDL_LockMutex(m_lock);
+    record->m_valid = 0;
+    std::atomic_signal_fence(std::memory_order_release);
+    std::memcpy(record->m_tiles, chunk.m_tiles, sizeof(chunk.m_tiles));
+    std::memcpy(record->m_passable, chunk.m_passable, sizeof(chunk.m_passable));
+    std::atomic_signal_fence(std::memory_order_release);
+    record->m_valid = VALID;
+    SDL_UnlockMutex(m_lock);
+    return true;
+}
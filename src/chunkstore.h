@@ -0,0 +1,85 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef CHUNKSTORE_H
+#define CHUNKSTORE_H
+
+#include <string>
+#include <cstdint>
+#include "terrain.h"
+
+struct SDL_mutex;
+
+/**
+ * On-disk cache of generated chunks, one memory-mapped file per seed.
+ * Chunks within RADIUS of the origin have a fixed-size record at a fixed
+ * offset, chunks further away are not stored. At most STORES files are
+ * kept, a new seed takes over the one opened least recently.
+ */
+class ChunkStore {
+public:
+    enum { RADIUS = 32, VERSION = 2 }; // bump VERSION when Terrain output changes
+    enum { STORES = 4 };
+
+    ChunkStore();
+    ~ChunkStore();
+
+    ChunkStore(const ChunkStore&) = delete;
+    ChunkStore& operator=(const ChunkStore&) = delete;
+
+    bool open(const std::string& fileName, int seed);
+    void close();
+
+    // seed and time of the last open of a store file, false if it is not one
+    static bool getInfo(const std::string& fileName, int& seed, int64_t& used);
+
+    bool load(const vec2i& chunk_pos, Chunk& chunk) const;
+    bool save(const vec2i& chunk_pos, const Chunk& chunk);
+
+    inline bool isOpen() const {
+        return m_data != nullptr;
+    }
+private:
+    struct Header {
+        char     m_magic[8];
+        uint32_t m_version;
+        int32_t  m_seed;
+        uint32_t m_record_size;
+        int32_t  m_radius;
+        int64_t  m_used;   // time of the last open
+    };
+    struct Record {
+        uint32_t m_valid; // set after the data is written, see save()
+        uint32_t m_reserved;
+        Tile     m_tiles[Chunk::SIZE][Chunk::SIZE];
+        uint64_t m_passable[Chunk::SIZE];
+    };
+    enum { HEADER_SIZE = 4096 };
+
+    Record* getRecord(const vec2i& chunk_pos) const;
+
+    uint8_t* m_data;
+    size_t   m_size;
+#ifdef _WIN32
+    void*    m_file;
+    void*    m_mapping;
+#else
+    int      m_file;
+#endif
+    SDL_mutex* m_lock; // record copies, loads run on workers
+};
+
+#endif
@@ -0,0 +1,165 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "entities.h"
+
+/**
+ * Append a new entity, alive and updated every frame.
+ * The position is copied, spawns often pass one of another entity.
+ */
+Entities::Id Entities::create(Object* object, unsigned type, unsigned flags, vec2f pos) {
+    Id id;
+    if (m_free.empty()) {
+        id = (Id)m_dense.size();
+        m_dense.push_back(0);
+    }
+    else {
+        id = m_free.back();
+        m_free.pop_back();
+    }
+    m_dense[id] = (uint32_t)m_id.size();
+
+    m_pos.push_back(pos);
+    m_prev.push_back(pos);
+    m_vel.push_back(vec2f());
+    m_z.push_back(2);
+    m_type.push_back(type);
+    m_flags.push_back(flags);
+    m_state.push_back(ALIVE | THINK);
+    m_age.push_back(0);
+    m_ttl.push_back(0);
+    m_frame.push_back(0);
+    m_rate.push_back(0);
+    m_frames.push_back(1);
+    m_anim.push_back(ANIM_NONE);
+    m_object.push_back(object);
+    m_id.push_back(id);
+    return id;
+}
+
+/**
+ * Remove entity, the last one takes its place
+ */
+void Entities::destroy(Id id) {
+    uint32_t i = m_dense[id];
+    uint32_t last = (uint32_t)m_id.size() - 1;
+
+    if (i != last) {
+        m_pos[i]    = m_pos[last];
+        m_prev[i]   = m_prev[last];
+        m_vel[i]    = m_vel[last];
+        m_z[i]      = m_z[last];
+        m_type[i]   = m_type[last];
+        m_flags[i]  = m_flags[last];
+        m_state[i]  = m_state[last];
+        m_age[i]    = m_age[last];
+        m_ttl[i]    = m_ttl[last];
+        m_frame[i]  = m_frame[last];
+        m_rate[i]   = m_rate[last];
+        m_frames[i] = m_frames[last];
+        m_anim[i]   = m_anim[last];
+        m_object[i] = m_object[last];
+        m_id[i]     = m_id[last];
+        m_dense[m_id[i]] = i;
+    }
+
+    m_pos.pop_back();
+    m_prev.pop_back();
+    m_vel.pop_back();
+    m_z.pop_back();
+    m_type.pop_back();
+    m_flags.pop_back();
+    m_state.pop_back();
+    m_age.pop_back();
+    m_ttl.pop_back();
+    m_frame.pop_back();
+    m_rate.pop_back();
+    m_frames.pop_back();
+    m_anim.pop_back();
+    m_object.pop_back();
+    m_id.pop_back();
+    m_free.push_back(id);
+}
+
+/**
+ * Restart the age, the entity expires after ttl seconds (0 - never)
+ */
+void Entities::setTtl(Id id, float ttl) {
+    uint32_t i = m_dense[id];
+    m_age[i] = 0;
+    m_ttl[i] = ttl;
+    m_state[i] &= ~EXPIRED;
+}
+
+/**
+ * Start animation from the first frame
+ */
+void Entities::setAnimation(Id id, Animation mode, int frames, float rate) {
+    uint32_t i = m_dense[id];
+    m_anim[i] = mode;
+    m_frames[i] = frames;
+    m_rate[i] = rate;
+    m_frame[i] = 0;
+    m_state[i] &= ~STOPPED;
+}
+
+/**
+ * Remember positions, collisions move entities back there
+ */
+void Entities::saveMotion() {
+    m_prev = m_pos;
+}
+
+void Entities::updateMotion(float dt) {
+    for (size_t i = 0; i < m_pos.size(); ++i) {
+        m_pos[i] += m_vel[i] * dt;
+    }
+}
+
+/**
+ * Grow older, expired entities are woken up once
+ */
+void Entities::updateAges(float dt) {
+    for (size_t i = 0; i < m_age.size(); ++i) {
+        m_age[i] += dt;
+        if (m_ttl[i] > 0 && m_age[i] >= m_ttl[i] && !(m_state[i] & EXPIRED)) {
+            m_state[i] |= EXPIRED | WAKE;
+        }
+    }
+}
+
+/**
+ * Advance frames, looped animations start over, one-shot ones stop
+ * at the end and wake the entity up
+ */
+void Entities::updateAnimations(float dt) {
+    for (size_t i = 0; i < m_frame.size(); ++i) {
+        if (m_anim[i] == ANIM_NONE || (m_state[i] & STOPPED)) {
+            continue;
+        }
+        m_frame[i] += m_rate[i] * dt;
+
+        if (m_frame[i] >= m_frames[i]) {
+            if (m_anim[i] == ANIM_LOOP) {
+                m_frame[i] = 0;
+            }
+            else {
+                m_frame[i] = m_frames[i] - 1;
+                m_state[i] |= STOPPED | WAKE;
+            }
+        }
+    }
+}
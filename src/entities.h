@@ -0,0 +1,169 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ENTITIES_H
+#define ENTITIES_H
+
+#include <cstdint>
+#include <vector>
+#include "vec.h"
+
+class Object;
+
+/**
+ * Entity data in structure-of-arrays pools, so systems run over
+ * contiguous arrays instead of following object pointers.
+ * Entities are addressed by stable ids while the arrays stay dense:
+ * removal moves the last entity into the hole.
+ */
+class Entities {
+public:
+    typedef uint32_t Id;
+    static const Id NONE = ~Id(0);
+
+    // bits of the per entity state
+    enum State {
+        ALIVE   = 1 << 0,
+        THINK   = 1 << 1, // object is updated every frame
+        WAKE    = 1 << 2, // object is updated once, set by systems on events
+        EXPIRED = 1 << 3, // age reached time to live
+        STOPPED = 1 << 4, // one-shot animation reached its last frame
+    };
+    enum Animation { ANIM_NONE, ANIM_LOOP, ANIM_ONCE };
+
+    // object is the behaviour bound to the entity, if any
+    Id create(Object* object, unsigned type, unsigned flags, vec2f pos);
+    void destroy(Id id);
+
+    inline size_t size() const {
+        return m_id.size();
+    }
+
+    // access by id
+    inline Object* getObject(Id id) const {
+        return m_object[m_dense[id]];
+    }
+    inline const vec2f& getPosition(Id id) const {
+        return m_pos[m_dense[id]];
+    }
+    inline void setPosition(Id id, const vec2f& pos) {
+        m_pos[m_dense[id]] = pos;
+    }
+    inline const vec2f& getPrevPosition(Id id) const {
+        return m_prev[m_dense[id]];
+    }
+    // between the position before the last update and the current one
+    inline vec2f getInterpolated(Id id, float alpha) const {
+        uint32_t i = m_dense[id];
+        return m_prev[i] + (m_pos[i] - m_prev[i]) * alpha;
+    }
+    inline const vec2f& getVelocity(Id id) const {
+        return m_vel[m_dense[id]];
+    }
+    inline void setVelocity(Id id, const vec2f& vel) {
+        m_vel[m_dense[id]] = vel;
+    }
+    inline int getZ(Id id) const {
+        return m_z[m_dense[id]];
+    }
+    inline void setZ(Id id, int z) {
+        m_z[m_dense[id]] = z;
+    }
+    inline unsigned getType(Id id) const {
+        return m_type[m_dense[id]];
+    }
+    inline void setType(Id id, unsigned type) {
+        m_type[m_dense[id]] = type;
+    }
+    inline unsigned getFlags(Id id) const {
+        return m_flags[m_dense[id]];
+    }
+    inline void setFlags(Id id, unsigned flags) {
+        m_flags[m_dense[id]] = flags;
+    }
+    inline unsigned getState(Id id) const {
+        return m_state[m_dense[id]];
+    }
+    inline void setState(Id id, unsigned bits, bool on) {
+        unsigned& state = m_state[m_dense[id]];
+        state = on ? (state | bits) : (state & ~bits);
+    }
+    inline float getAge(Id id) const {
+        return m_age[m_dense[id]];
+    }
+    inline float getTtl(Id id) const {
+        return m_ttl[m_dense[id]];
+    }
+    inline float getFrame(Id id) const {
+        return m_frame[m_dense[id]];
+    }
+    void setTtl(Id id, float ttl);
+    void setAnimation(Id id, Animation mode, int frames, float rate);
+
+    // update of an object is due, clears the wake up
+    inline bool checkUpdate(Id id) {
+        unsigned& state = m_state[m_dense[id]];
+        bool due = (state & (THINK | WAKE)) != 0;
+        state &= ~WAKE;
+        return due;
+    }
+
+    // dense access for loops over all entities
+    inline size_t getIndex(Id id) const {
+        return m_dense[id];
+    }
+    inline Object* getObjectAt(size_t i) const {
+        return m_object[i];
+    }
+    inline const vec2f& getPositionAt(size_t i) const {
+        return m_pos[i];
+    }
+    inline const vec2f& getPrevPositionAt(size_t i) const {
+        return m_prev[i];
+    }
+    inline unsigned getFlagsAt(size_t i) const {
+        return m_flags[i];
+    }
+
+    // systems
+    void saveMotion();
+    void updateMotion(float dt);
+    void updateAges(float dt);
+    void updateAnimations(float dt);
+
+private:
+    // components, indexed by dense position
+    std::vector<vec2f>    m_pos;
+    std::vector<vec2f>    m_prev; // position before this frame's movement
+    std::vector<vec2f>    m_vel;
+    std::vector<int>      m_z;
+    std::vector<unsigned> m_type;
+    std::vector<unsigned> m_flags;
+    std::vector<unsigned> m_state;
+    std::vector<float>    m_age;
+    std::vector<float>    m_ttl;  // 0 - forever
+    std::vector<float>    m_frame;
+    std::vector<float>    m_rate; // frames per second
+    std::vector<int>      m_frames;
+    std::vector<uint8_t>  m_anim;
+    std::vector<Object*>  m_object;
+
+    std::vector<Id>       m_id;    // dense position -> id
+    std::vector<uint32_t> m_dense; // id -> dense position
+    std::vector<Id>       m_free;  // ids to reuse
+};
+
+#endif
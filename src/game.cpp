@@ -15,7 +15,12 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <iostream>
+#include <fstream>
 #include <stdexcept>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <ctime>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <SDL.h>
@@ -23,7 +28,11 @@
 #include <SDL_mixer.h>
 #include <SDL_ttf.h>
 #include "game.h"
+#include "chunkstore.h"
+#include "glyphatlas.h"
+#include "spritebatch.h"
 #include "menu.h"
+#include "replay.h"
 #include "world.h"
 
 Game::Game() :
@@ -31,7 +40,21 @@ Game::Game() :
     m_window(nullptr),
     m_renderer(nullptr),
     m_fullScreen(true),
-    m_musicEnabled(true)
+    m_musicEnabled(true),
+    m_headless(false),
+    m_simSeconds(0),
+    m_seeded(false),
+    m_seed(0),
+    m_stepRate(60),
+    m_maxSteps(5),
+    m_refreshRate(60),
+    m_vsync(false),
+    m_fastFrames(0),
+    m_chunkBudget(0),
+    m_chunkBudgetSet(false),
+    m_chunkBudgetBytes(0),
+    m_chunkStore(false),
+    m_pathBudget(0)
 {
 }
 
@@ -43,6 +66,11 @@ Game::~Game() {
  * Free resources
  */
 void Game::destroy() {
+    // states free their textures, the renderer must still exist
+    m_states.clear();
+    m_purgatory.clear();
+    m_glyphs.clear();
+
     for (auto it : m_sounds) {
         if (it.second) Mix_FreeChunk(it.second);
     }
@@ -62,6 +90,8 @@ void Game::destroy() {
         if (it.second) SDL_DestroyTexture(it.second);
     }
     m_textures.clear();
+    m_atlas.clear();
+    m_sprites.clear();
 
     if (m_renderer) {
         SDL_DestroyRenderer(m_renderer);
@@ -83,11 +113,60 @@ void Game::destroy() {
 void Game::init(int argc, char* argv[]) {
     // parse command line
     int opt;
-    while ((opt = getopt(argc, argv, "mvw")) != -1) {
+    while ((opt = getopt(argc, argv, "c:e:k:mn:o:p:r:st:vw")) != -1) {
         switch (opt) {
+            case 'c': {
+                // chunk cache budget: "256" chunks (0 - unlimited) or "16M" bytes
+                char* suffix = nullptr;
+                size_t value = std::isdigit(static_cast<unsigned char>(*optarg)) ? std::strtoul(optarg, &suffix, 10) : 0;
+
+                if (suffix == nullptr || suffix == optarg || (suffix[0] && suffix[1])) {
+                    throw std::runtime_error("Invalid chunk budget: " + std::string(optarg));
+                }
+                switch (std::toupper(*suffix)) {
+                    case 'G': value *= 1024; // fall through
+                    case 'M': value *= 1024; // fall through
+                    case 'K': value *= 1024;
+                        m_chunkBudgetBytes = value;
+                        break;
+                    case 0:
+                        m_chunkBudget = value;
+                        m_chunkBudgetSet = true;
+                        break;
+                    default:
+                        throw std::runtime_error("Invalid chunk budget: " + std::string(optarg));
+                }
+                break;
+            }
+            case 'e':
+                m_seed = std::atoi(optarg);
+                m_seeded = true;
+                break;
+            case 'k':
+                m_maxSteps = std::max(1, std::atoi(optarg));
+                break;
             case 'm':
                 m_musicEnabled = false;
                 break;
+            case 'n':
+                m_pathBudget = std::max(1, std::atoi(optarg));
+                break;
+            case 'o':
+                m_recordFile = optarg;
+                break;
+            case 'p':
+                m_replayFile = optarg;
+                break;
+            case 'r':
+                m_stepRate = std::min<int>(std::max<int>(MIN_STEP_RATE, std::atoi(optarg)), MAX_STEP_RATE);
+                break;
+            case 's':
+                m_chunkStore = true;
+                break;
+            case 't':
+                m_simSeconds = std::atof(optarg);
+                m_headless = true;
+                break;
             case 'v':
                 std::cout << PROJECT_NAME << " (compiled " << BUILD_DATE << " " << BUILD_TIME << ")" << std::endl;
                 std::cout << "Revision: " << PROJECT_VERSION << std::endl;
@@ -104,11 +183,32 @@ void Game::init(int argc, char* argv[]) {
         SDL_free(base_path);
     }
 
+    // replays run with the seed and step rate they were recorded with
+    if (!m_replayFile.empty()) {
+        Replay replay;
+        replay.open(m_replayFile);
+        m_seed = replay.getSeed();
+        m_seeded = true;
+        m_stepRate = replay.getStepRate();
+    }
+
+    // the seed is reported by headless runs and recorded, so games can be repeated
+    if ((m_headless || !m_recordFile.empty()) && !m_seeded) {
+        m_seed = int(std::time(nullptr));
+        m_seeded = true;
+    }
+
     // init SDL subsystems
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
+    if (SDL_Init(m_headless ? SDL_INIT_TIMER : SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
         throw std::runtime_error(SDL_GetError());
     }
 
+    // objects still need sprite layouts to animate
+    if (m_headless) {
+        loadSprites();
+        return;
+    }
+
     if ((IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG) == 0) {
         throw std::runtime_error(IMG_GetError());
     }
@@ -139,9 +239,23 @@ void Game::init(int argc, char* argv[]) {
         throw std::runtime_error(SDL_GetError());
     }
 
+    // pace frames by the display if present does not
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(m_renderer, &info) == 0) {
+        m_vsync = (info.flags & SDL_RENDERER_PRESENTVSYNC) != 0;
+    }
+    SDL_DisplayMode mode;
+    if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(m_window), &mode) == 0 && mode.refresh_rate > 0) {
+        m_refreshRate = mode.refresh_rate;
+    }
+
     SDL_SetRenderDrawBlendMode(m_renderer, SDL_BLENDMODE_BLEND);
     SDL_RenderSetLogicalSize(m_renderer, 800, 600);
 
+    m_batch = std::make_unique<SpriteBatch>(m_renderer);
+    loadAtlas();
+    loadSprites();
+
     // start background music
     if (m_musicEnabled) {
         if (Mix_PlayMusic(getMusic("music.ogg"), -1) < 0) {
@@ -158,7 +272,34 @@ void Game::pushState(int state) {
         m_states.push_back(std::make_unique<Menu>(*this));
     }
     else if (state == STATE_WORLD) {
-        m_states.push_back(std::make_unique<World>(*this, SDL_GetTicks()));
+        int seed = m_seeded ? m_seed : SDL_GetTicks();
+        auto world = std::make_unique<World>(*this, seed);
+
+        // recorded, replayed and headless games are repeated from the seed and actions.
+        // Waiting for chunks stalls frames, so a seed alone does not turn it on.
+        world->setDeterministic(m_headless || !m_recordFile.empty() || !m_replayFile.empty());
+
+        if (!m_replayFile.empty()) {
+            auto replay = std::make_unique<Replay>();
+            replay->open(m_replayFile);
+            world->setReplay(std::move(replay));
+        }
+        else if (!m_recordFile.empty()) {
+            auto replay = std::make_unique<Replay>();
+            replay->create(m_recordFile, seed, m_stepRate);
+            world->setReplay(std::move(replay));
+        }
+
+        if (m_chunkBudgetBytes) {
+            world->setChunkMemoryBudget(m_chunkBudgetBytes);
+        }
+        else if (m_chunkBudgetSet) {
+            world->setChunkBudget(m_chunkBudget);
+        }
+        if (m_pathBudget) {
+            world->setPathBudget(m_pathBudget);
+        }
+        m_states.push_back(std::move(world));
     }
 }
 
@@ -173,13 +314,26 @@ void Game::popState() {
 }
 
 /**
- * Main loop
+ * Main loop. The top state is updated in fixed steps,
+ * rendering shows where objects are between the last two.
  */
 void Game::run() {
-    Uint32 currentTime = SDL_GetTicks();
+    if (m_headless) {
+        simulate();
+        return;
+    }
+
+    const Uint64 step = SDL_GetPerformanceFrequency() / m_stepRate;
+    const float dt = 1.0f / m_stepRate;
+    Uint64 previous = SDL_GetPerformanceCounter();
+    Uint64 accumulator = 0;
     SDL_Event ev;
 
     while (!m_states.empty())  {
+        Uint64 frame_start = SDL_GetPerformanceCounter();
+        accumulator += frame_start - previous;
+        previous = frame_start;
+
         // input
         while (SDL_PollEvent(&ev) != 0) {
             if (ev.type == SDL_QUIT) {
@@ -196,50 +350,186 @@ void Game::run() {
                 SDL_SetWindowFullscreen(m_window, m_fullScreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0);
             }
 
-            if (!m_states.empty()) {
+            // every state may own render targets, not only the active one
+            if (ev.type == SDL_RENDER_TARGETS_RESET || ev.type == SDL_RENDER_DEVICE_RESET) {
+                for (auto& state : m_states) {
+                    state->onEvent(ev);
+                }
+            }
+            else if (!m_states.empty()) {
                 m_states.back()->onEvent(ev);
             }
         }
 
-        Uint32 time = SDL_GetTicks();
-        float dt = (time - currentTime) / 1000.0;
-        currentTime = time;
-
         // update
-        if (!m_states.empty()) {
+        for (int i = 0; i < m_maxSteps && accumulator >= step && !m_states.empty(); ++i) {
             m_states.back()->update(dt);
+            accumulator -= step;
+        }
+        // too far behind to catch up, slow the simulation down instead
+        if (accumulator >= step) {
+            accumulator %= step;
         }
         m_purgatory.clear();
 
-        // render
+        // render, states below the top one are not updated and stay put
         SDL_SetRenderDrawColor(m_renderer, 0x00, 0x00, 0x00, 0xFF);
         SDL_RenderClear(m_renderer);
 
-        for (auto& it : m_states) {
-            it->render(m_renderer);
+        for (size_t i = 0; i < m_states.size(); ++i) {
+            m_states[i]->render(m_renderer, i + 1 == m_states.size() ? float(accumulator) / step : 1.0f);
         }
 
+        m_batch->endFrame();
         SDL_RenderPresent(m_renderer);
-        SDL_Delay(20);
+        waitFrame(frame_start);
+    }
+}
+
+/**
+ * Update the top state in fixed steps as fast as possible,
+ * then report how much faster than real time the simulation ran
+ */
+void Game::simulate() {
+    const float dt = 1.0f / m_stepRate;
+    const long steps = long(m_simSeconds * m_stepRate);
+    const Uint64 start = SDL_GetPerformanceCounter();
+    long step = 0;
+
+    for (; step < steps && !m_states.empty(); ++step) {
+        m_states.back()->update(dt);
+        m_purgatory.clear();
+    }
+
+    double wall = double(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    double sim = double(step) / m_stepRate;
+
+    std::cout << "Seed " << m_seed << ": " << sim << " s simulated in " << wall << " s, "
+              << sim / wall << " simulated seconds per second" << std::endl;
+}
+
+/**
+ * Keep frames a display refresh apart. With vsync presenting waits already,
+ * unless the driver ignores it, e.g. for hidden windows, which shows as
+ * frames finishing much faster than the display refreshes.
+ */
+void Game::waitFrame(uint64_t frame_start) {
+    const Uint64 frequency = SDL_GetPerformanceFrequency();
+    const Uint64 period = frequency / m_refreshRate;
+    const Uint64 target = frame_start + period;
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    if (m_vsync) {
+        m_fastFrames = (now - frame_start < period / 2) ? m_fastFrames + 1 : 0;
+        if (m_fastFrames < 10) {
+            return;
+        }
+        SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Present does not wait for vsync, limiting frames to %d Hz", m_refreshRate);
+        m_vsync = false;
+    }
+
+    // sleep is coarse, spin for the last couple of milliseconds
+    while (now < target) {
+        Uint64 left_ms = (target - now) * 1000 / frequency;
+        if (left_ms > 2) {
+            SDL_Delay(Uint32(left_ms - 2));
+        }
+        now = SDL_GetPerformanceCounter();
     }
 }
 
 /**
  * Load and cache textures
  */
-SDL_Texture* Game::getTexture(const std::string& fileName) {
-    SDL_Texture* texture = m_textures[fileName];
+SDL_Texture* Game::loadTexture(const std::string& path) {
+    SDL_Texture* texture = m_textures[path];
 
     if (texture == nullptr) {
-        SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Load: %s", fileName.c_str());
-        if ((texture = IMG_LoadTexture(m_renderer, getDataFile("gfx/" + fileName).c_str())) == nullptr) {
+        SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Load: %s", path.c_str());
+        if ((texture = IMG_LoadTexture(m_renderer, getDataFile(path).c_str())) == nullptr) {
             throw std::runtime_error(IMG_GetError());
         }
-        m_textures[fileName] = texture;
+        m_textures[path] = texture;
+    }
+    return texture;
+}
+
+SDL_Texture* Game::getTexture(const std::string& fileName) {
+    return loadTexture("gfx/" + fileName);
+}
+
+/**
+ * Get texture and placement of a sprite sheet.
+ * Sheets packed into the atlas come from its page, others from their own file.
+ */
+SDL_Texture* Game::getSheet(const std::string& fileName, vec2i& origin, vec2i& size) {
+    auto it = m_atlas.find(fileName);
+    if (it != m_atlas.end()) {
+        origin = it->second.m_origin;
+        size = it->second.m_size;
+        return loadTexture("atlas/" + it->second.m_page);
+    }
+
+    SDL_Texture* texture = getTexture(fileName);
+    if (SDL_QueryTexture(texture, nullptr, nullptr, &size.x, &size.y) < 0) {
+        throw std::runtime_error(SDL_GetError());
     }
+    origin = vec2i();
     return texture;
 }
 
+/**
+ * Read the atlas table, sheets are loaded from their own files without it
+ */
+void Game::loadAtlas() {
+    std::ifstream table(getDataFile("atlas/atlas.txt"));
+    std::string name;
+    AtlasSheet sheet;
+
+    m_atlas.clear();
+    while (table >> name >> sheet.m_page >> sheet.m_origin.x >> sheet.m_origin.y >> sheet.m_size.x >> sheet.m_size.y) {
+        m_atlas[name] = sheet;
+    }
+    SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Atlas: %zu sheets", m_atlas.size());
+}
+
+/**
+ * Load sprite definitions shared by all objects
+ */
+void Game::loadSprites() {
+    static const struct {
+        int         id;
+        const char* file;
+        vec2i       size;
+        vec2i       offset;
+        int         start;
+        int         count;
+    } defs[] = {
+        {SPRITE_TILES + 16,        "trees.png",    {128, 192}, {64, 160},  0, 1},
+        {SPRITE_SNOWBALL + 0,      "snowball.png", { 64,  64}, {32,  12},  0, 1}, // shadow
+        {SPRITE_SNOWBALL + 1,      "snowball.png", { 64,  64}, {32,  12},  1, 1}, // flying
+        {SPRITE_SNOWBALL + 2,      "snowball.png", { 64,  64}, {32,  12},  1, 8}, // explosion
+    };
+    static const struct {
+        int start;
+        int count;
+    } character[] = {{8, 1}, {0, 8}, {8, 5}, {13, 3}, {16, 8}, {24, 8}, {31, 1}}; // idle, walk, throw, hit, die, dead
+
+    m_sprites.clear();
+    m_sprites.resize(SPRITE_COUNT);
+
+    for (int i = 0; i < 16; ++i) {
+        m_sprites[SPRITE_TILES + i].load(*this, "tiles.png", vec2i(64, 128), vec2i(32, 112), i, 1);
+    }
+    for (auto& def : defs) {
+        m_sprites[def.id].load(*this, def.file, def.size, def.offset, def.start, def.count);
+    }
+    for (int i = 0; i < 7; ++i) {
+        m_sprites[SPRITE_CHARACTER_RED + i ].load(*this, "character-red.png",  vec2i(128, 128), vec2i(64, 94), character[i].start, character[i].count);
+        m_sprites[SPRITE_CHARACTER_BLUE + i].load(*this, "character-blue.png", vec2i(128, 128), vec2i(64, 94), character[i].start, character[i].count);
+    }
+}
+
 /**
  * Load and cache fonts
  */
@@ -257,6 +547,19 @@ TTF_Font* Game::getFont(const std::string& fileName, int ptsize) {
     return font;
 }
 
+/**
+ * Glyph atlas of a font, created on first use
+ */
+GlyphAtlas& Game::getGlyphs(const std::string& fileName, int ptsize) {
+    std::string key = fileName + ":" + std::to_string(ptsize);
+    std::unique_ptr<GlyphAtlas>& glyphs = m_glyphs[key];
+
+    if (!glyphs) {
+        glyphs = std::make_unique<GlyphAtlas>(m_renderer, *m_batch, getFont(fileName, ptsize));
+    }
+    return *glyphs;
+}
+
 /**
  * Load and cache audiofiles
  */
@@ -273,6 +576,17 @@ Mix_Chunk* Game::getSound(const std::string& fileName) {
     return chunk;
 }
 
+/**
+ * Play a sound once, does nothing in headless games.
+ * Returns false if the mixer failed.
+ */
+bool Game::playSound(const std::string& fileName) {
+    if (m_headless) {
+        return true;
+    }
+    return Mix_PlayChannel(-1, getSound(fileName), 0) >= 0;
+}
+
 /**
  * Load and cache music
  */
@@ -289,6 +603,39 @@ Mix_Music* Game::getMusic(const std::string& fileName) {
     return music;
 }
 
+/**
+ * Get chunk store file for the seed in user's data directory, empty if disabled.
+ * A seed without a store reuses the least recently opened of the files.
+ */
+const std::string Game::getChunkStoreFile(int seed) const {
+    std::string path;
+
+    if (m_chunkStore) {
+        char *pref_path = SDL_GetPrefPath("qborki", PROJECT_NAME.c_str());
+        if (pref_path == nullptr) {
+            return path;
+        }
+
+        int64_t oldest = INT64_MAX;
+        for (int i = 0; i < ChunkStore::STORES; ++i) {
+            std::string fileName = std::string(pref_path) + "chunks-" + std::to_string(i) + ".bin";
+            int store_seed = 0;
+            int64_t used = 0; // missing or foreign files are taken first
+
+            if (ChunkStore::getInfo(fileName, store_seed, used) && store_seed == seed) {
+                path = fileName;
+                break;
+            }
+            if (used < oldest) {
+                path = fileName;
+                oldest = used;
+            }
+        }
+        SDL_free(pref_path);
+    }
+    return path;
+}
+
 /**
  * Resolve resource filename
  */
@@ -17,15 +17,20 @@
 #ifndef GAME_H
 #define GAME_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include "sprite.h"
 #include "state.h"
+#include "vec.h"
 
 struct SDL_Window;
 struct SDL_Renderer;
 struct SDL_Texture;
+class  SpriteBatch;
+class  GlyphAtlas;
 struct Mix_Chunk;
 typedef struct _Mix_Music Mix_Music;
 typedef struct _TTF_Font TTF_Font;
@@ -34,6 +39,19 @@ class Game {
 public:
     enum {STATE_MENU, STATE_WORLD};
 
+    // fixed step rates (steps per second) objects move correctly at, a snowball
+    // must not pass a tile in one step and a walker must not step past a waypoint
+    enum {MIN_STEP_RATE = 30, MAX_STEP_RATE = 1000};
+
+    // shared sprite definitions, first ids of each group
+    enum {
+        SPRITE_TILES          = 0,  // tiles and a tree, indexed by tile layer values
+        SPRITE_SNOWBALL       = 17, // Snowball states
+        SPRITE_CHARACTER_RED  = 20, // Character states
+        SPRITE_CHARACTER_BLUE = 27,
+        SPRITE_COUNT          = 34
+    };
+
     Game();
     ~Game();
 
@@ -46,27 +64,61 @@ public:
 
     // Resource manager
     SDL_Texture* getTexture(const std::string& fileName);
+    SDL_Texture* getSheet(const std::string& fileName, vec2i& origin, vec2i& size);
     TTF_Font*    getFont(const std::string& fileName, int ptsize);
+    GlyphAtlas&  getGlyphs(const std::string& fileName, int ptsize);
     Mix_Chunk*   getSound(const std::string& fileName);
+    bool         playSound(const std::string& fileName);
     Mix_Music*   getMusic(const std::string& fileName);
+    const std::string getChunkStoreFile(int seed) const;
+
+    // no window, renderer or audio, states are only updated
+    inline bool isHeadless() const {
+        return m_headless;
+    }
     inline SDL_Renderer* getRenderer() {
         return m_renderer;
     }
+    inline SpriteBatch& getBatch() {
+        return *m_batch;
+    }
+
+    // a group of sprites, loaded once and shared by all objects
+    inline const Sprite* getSprites(int first) const {
+        return &m_sprites[first];
+    }
 
 private:
     const std::string getDataFile(const std::string&) const;
+    SDL_Texture* loadTexture(const std::string& path);
+    void loadAtlas();
+    void loadSprites();
+    void waitFrame(uint64_t frame_start);
+    void simulate();
 
     std::string m_base_path;
 
     SDL_Window*   m_window;
     SDL_Renderer* m_renderer;
+    std::unique_ptr<SpriteBatch> m_batch; // outlives states and their sprites
 
     // assets cache
     std::unordered_map<std::string, SDL_Texture*> m_textures;
     std::unordered_map<std::string, TTF_Font*>    m_fonts;
+    std::unordered_map<std::string, std::unique_ptr<GlyphAtlas>> m_glyphs; // by font key
     std::unordered_map<std::string, Mix_Chunk*>   m_sounds;
     std::unordered_map<std::string, Mix_Music*>   m_music;
 
+    // sprite sheets packed into atlas pages by scripts/atlas.py
+    struct AtlasSheet {
+        std::string m_page;
+        vec2i m_origin;
+        vec2i m_size;
+    };
+    std::unordered_map<std::string, AtlasSheet> m_atlas;
+
+    std::vector<Sprite> m_sprites; // by SPRITE_ ids
+
     // active states stack (all are rendered, but only top is updated and gets input)
     std::vector<std::unique_ptr<State>> m_states;
     std::vector<std::unique_ptr<State>> m_purgatory;
@@ -74,6 +126,36 @@ private:
     bool m_fullScreen;
     bool m_musicEnabled;
 
+    // headless run of m_simSeconds simulated seconds, as fast as possible
+    bool  m_headless;
+    float m_simSeconds;
+
+    // world seed, random unless set
+    bool m_seeded;
+    int  m_seed;
+
+    // player actions are recorded to or played back from these (empty - off)
+    std::string m_recordFile;
+    std::string m_replayFile;
+
+    // simulation runs in fixed steps, a slow frame is caught up with at most m_maxSteps
+    int  m_stepRate; // steps per second
+    int  m_maxSteps;
+
+    // frame pacing, presenting waits for the display unless vsync turns out to be ignored
+    int  m_refreshRate;
+    bool m_vsync;
+    int  m_fastFrames; // frames in a row which finished well before the display refresh
+
+    // world chunk cache limit, either in chunks (0 - unlimited) or in bytes (0 - default)
+    size_t m_chunkBudget;
+    bool   m_chunkBudgetSet;
+    size_t m_chunkBudgetBytes;
+    bool   m_chunkStore;
+
+    // max nodes expanded per path search (0 - default)
+    unsigned m_pathBudget;
+
     // version and executable link time (set by build scripts)
     static const std::string PROJECT_NAME;
     static const std::string PROJECT_VERSION;
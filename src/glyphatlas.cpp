@@ -0,0 +1,128 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <stdexcept>
+#include <SDL_ttf.h>
+#include "glyphatlas.h"
+#include "spritebatch.h"
+
+GlyphAtlas::GlyphAtlas(SDL_Renderer* renderer, SpriteBatch& batch, TTF_Font* font) :
+    m_renderer(renderer),
+    m_batch(batch),
+    m_font(font),
+    m_height(TTF_FontHeight(font)),
+    m_page_size(256),
+    m_shelf_height(0),
+    m_uploads(0),
+    m_glyphs()
+{
+    // room for about a hundred glyphs per page
+    while (m_page_size < m_height * 10 && m_page_size < 2048) {
+        m_page_size *= 2;
+    }
+    m_shelf = vec2i(0, m_page_size); // first glyph opens a page
+}
+
+GlyphAtlas::~GlyphAtlas() {
+    for (SDL_Texture* page : m_pages) {
+        m_batch.release(page);
+        SDL_DestroyTexture(page);
+    }
+}
+
+/**
+ * Render a glyph into the atlas unless it is there already
+ */
+const GlyphAtlas::Glyph& GlyphAtlas::getGlyph(unsigned char c) {
+    Glyph& glyph = m_glyphs[c];
+
+    if (glyph.m_texture == nullptr) {
+        int maxx, miny, maxy;
+        if (TTF_GlyphMetrics(m_font, c, &glyph.m_minx, &maxx, &miny, &maxy, &glyph.m_advance) < 0) {
+            throw std::runtime_error(TTF_GetError());
+        }
+
+        SDL_Surface* rendered = TTF_RenderGlyph_Blended(m_font, c, SDL_Color{0xff, 0xff, 0xff, 0xff});
+        if (rendered == nullptr) {
+            throw std::runtime_error(TTF_GetError());
+        }
+        SDL_Surface* surface = SDL_ConvertSurfaceFormat(rendered, SDL_PIXELFORMAT_ARGB8888, 0);
+        SDL_FreeSurface(rendered);
+        if (surface == nullptr) {
+            throw std::runtime_error(SDL_GetError());
+        }
+
+        // shelf packing, one pixel apart so filtering does not bleed
+        if (m_shelf.x + surface->w > m_page_size) {
+            m_shelf = vec2i(0, m_shelf.y + m_shelf_height + 1);
+            m_shelf_height = 0;
+        }
+        if (m_shelf.y + surface->h > m_page_size) {
+            SDL_Texture* page = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, m_page_size, m_page_size);
+            if (page == nullptr || SDL_SetTextureBlendMode(page, SDL_BLENDMODE_BLEND) < 0) {
+                SDL_FreeSurface(surface);
+                throw std::runtime_error(SDL_GetError());
+            }
+            m_pages.push_back(page);
+            m_shelf = vec2i();
+            m_shelf_height = 0;
+        }
+
+        glyph.m_rect = {m_shelf.x, m_shelf.y, std::min(surface->w, m_page_size), std::min(surface->h, m_page_size)};
+        if (SDL_UpdateTexture(m_pages.back(), &glyph.m_rect, surface->pixels, surface->pitch) < 0) {
+            SDL_FreeSurface(surface);
+            throw std::runtime_error(SDL_GetError());
+        }
+        SDL_FreeSurface(surface);
+
+        glyph.m_texture = m_pages.back();
+        m_shelf.x += glyph.m_rect.w + 1;
+        m_shelf_height = std::max(m_shelf_height, glyph.m_rect.h);
+        m_uploads++;
+    }
+    return glyph;
+}
+
+/**
+ * Size of the text as TTF_SizeText would report it, without kerning
+ */
+vec2i GlyphAtlas::measure(const std::string& text) {
+    int width = 0;
+    for (unsigned char c : text) {
+        width += getGlyph(c).m_advance;
+    }
+    return vec2i(width, m_height);
+}
+
+void GlyphAtlas::draw(const std::string& text, const vec2i& pos, const SDL_Color& color, const vec2f& scale) {
+    vec2i size = measure(text);
+    float x = pos.x - size.x * scale.x / 2;
+    int y = int(pos.y - size.y * scale.y / 2);
+
+    for (unsigned char c : text) {
+        const Glyph& glyph = getGlyph(c);
+        SDL_Rect dst = {
+            int(x + std::min(glyph.m_minx, 0) * scale.x),
+            y,
+            int(glyph.m_rect.w * scale.x),
+            int(glyph.m_rect.h * scale.y)
+        };
+
+        m_batch.draw(glyph.m_texture, glyph.m_rect, dst, color);
+        x += glyph.m_advance * scale.x;
+    }
+}
@@ -0,0 +1,69 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef GLYPHATLAS_H
+#define GLYPHATLAS_H
+
+#include <string>
+#include <vector>
+#include <SDL.h>
+#include "vec.h"
+
+class SpriteBatch;
+typedef struct _TTF_Font TTF_Font;
+
+/**
+ * Glyphs of one font and size, rendered white on first use and packed
+ * into shared textures. Strings are laid out as one quad per glyph when
+ * drawn and tinted through vertex colors, so showing text again never
+ * touches the font or uploads anything.
+ */
+class GlyphAtlas {
+public:
+    GlyphAtlas(SDL_Renderer* renderer, SpriteBatch& batch, TTF_Font* font);
+    ~GlyphAtlas();
+
+    vec2i measure(const std::string& text);
+
+    // centered at pos, like sprites
+    void draw(const std::string& text, const vec2i& pos, const SDL_Color& color, const vec2f& scale = vec2f(1.0, 1.0));
+
+    // glyphs rendered and uploaded so far
+    inline unsigned getUploads() const {
+        return m_uploads;
+    }
+private:
+    struct Glyph {
+        SDL_Texture* m_texture; // nullptr - not rendered yet
+        SDL_Rect     m_rect;
+        int          m_minx;    // left bearing, the rendered glyph starts at min(minx, 0)
+        int          m_advance;
+    };
+    const Glyph& getGlyph(unsigned char c);
+
+    SDL_Renderer* m_renderer;
+    SpriteBatch&  m_batch;
+    TTF_Font*     m_font;
+    int           m_height;
+    int           m_page_size;
+    vec2i         m_shelf;        // next free spot on the last page
+    int           m_shelf_height;
+    unsigned      m_uploads;
+    std::vector<SDL_Texture*> m_pages;
+    Glyph         m_glyphs[256];  // Latin-1, same as TTF_RenderText
+};
+
+#endif
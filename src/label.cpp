@@ -14,35 +14,58 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <algorithm>
+#include "game.h"
+#include "glyphatlas.h"
 #include "world.h"
 #include "label.h"
 
 Label::Label(World& world, const vec2f& pos, const std::string& text, unsigned size, unsigned rgba, float ttl) :
-    Object(world, "Label", pos),
-    m_age(0),
-    m_ttl(ttl),
-    m_factor(0)
+    Object(world, "Label", TYPE_LABEL, pos),
+    m_glyphs(nullptr),
+    m_size(0)
 {
-    m_solid = false;
-    m_collider = false;
-    m_sprite.text(m_world.getGame(), text, "BebasNeue.otf", size, rgba);
+    show(text, size, rgba, ttl);
 }
 
+/**
+ * Show a pooled label again
+ */
+void Label::reset(const vec2f& pos, const std::string& text, unsigned size, unsigned rgba, float ttl) {
+    respawn(TYPE_LABEL, pos);
+    show(text, size, rgba, ttl);
+}
+
+void Label::show(const std::string& text, unsigned size, unsigned rgba, float ttl) {
+    setFlags(0);
+    setTtl(ttl);
+    setThink(false); // only woken up to expire
+
+    // the font lookup builds a string key, pooled labels mostly keep their size
+    if (size != m_size) {
+        m_glyphs = nullptr;
+        m_size = size;
+    }
+    m_text = text;
+    m_color = {Uint8(rgba >> 24), Uint8(rgba >> 16), Uint8(rgba >> 8), Uint8(rgba)};
+}
 
 void Label::render(SDL_Renderer* renderer, const vec2i& pos) {
-    m_sprite.render(renderer, pos + vec2i(0, -64 * (1 + m_factor)), 0, 0, vec2f(0.5, 0.5) * (1 + m_factor));
+    // inverse cubic
+    float factor = std::min(getAge() / getTtl(), 1.0f);
+    factor = 1 - factor;
+    factor = factor * factor * factor;
+    factor = 1 - factor;
+
+    // looked up on first draw, headless games have no fonts
+    if (m_glyphs == nullptr) {
+        m_glyphs = &m_world.getGame().getGlyphs("BebasNeue.otf", m_size);
+    }
+    m_glyphs->draw(m_text, pos + vec2i(0, -64 * (1 + factor)), m_color, vec2f(0.5, 0.5) * (1 + factor));
 }
 
 void Label::update(float dt) {
-    m_age += dt;
-    if (m_age >= m_ttl) {
-        m_age = m_ttl;
-        m_alive = 0;
+    if (checkState(Entities::EXPIRED)) {
+        kill();
     }
-
-    // inverse cubic
-    m_factor = m_age / m_ttl;
-    m_factor = 1 - m_factor;
-    m_factor = m_factor * m_factor * m_factor;
-    m_factor = 1 - m_factor;
 }
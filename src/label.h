@@ -17,20 +17,26 @@
 #ifndef LABEL_H
 #define LABEL_H
 
+#include <string>
+#include <SDL.h>
 #include "object.h"
-#include "sprite.h"
+
+class GlyphAtlas;
 
 class Label: public Object {
 public:
     Label(World& world, const vec2f& pos, const std::string& text, unsigned size, unsigned rgva, float ttl = 1);
+    void reset(const vec2f& pos, const std::string& text, unsigned size, unsigned rgba, float ttl = 1);
 
     void render(SDL_Renderer* renderer, const vec2i& pos);
     void update(float dt);
 private:
-    float m_age;
-    float m_ttl;
-    float m_factor;
-    Sprite m_sprite;
+    void show(const std::string& text, unsigned size, unsigned rgba, float ttl);
+
+    GlyphAtlas* m_glyphs; // shared by all labels of the size
+    unsigned    m_size;
+    std::string m_text;
+    SDL_Color   m_color;
 };
 #endif
 
@@ -20,7 +20,7 @@
 int main(int argc, char** argv) try {
     Game game;
     game.init(argc, argv);
-    game.pushState(Game::STATE_MENU);
+    game.pushState(game.isHeadless() ? Game::STATE_WORLD : Game::STATE_MENU);
     game.run();
     return 0;
 }
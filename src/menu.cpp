@@ -15,15 +15,18 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <SDL.h>
-#include <SDL_mixer.h>
 #include "game.h"
+#include "glyphatlas.h"
 #include "menu.h"
+#include "spritebatch.h"
 
 Menu::Menu(Game& game) :
     State(game),
     m_current(0),
     m_pos(400, 150),
-    m_size(256, 64)
+    m_size(256, 64),
+    m_caption_font(&game.getGlyphs("BebasNeue.otf", 96)),
+    m_button_font(&game.getGlyphs("BebasNeue.otf", 32))
 {
     std::vector<std::string> options = {"New Game", "Score", "Exit"};
 
@@ -31,31 +34,31 @@ Menu::Menu(Game& game) :
     for (size_t i = 0; i < options.size(); ++i) {
         m_buttons[i].m_id = i;
         m_buttons[i].m_pos = m_pos + vec2i(0, (m_size.y + 16) * i);
-        m_buttons[i].m_label.text(m_game, options[i], "BebasNeue.otf", 32, 0xa0a0a0ff);
+        m_buttons[i].m_label = options[i];
     }
 
     m_gradient_base.grad(m_game, m_size, 0x404080ff, 0x202040ff);
     m_gradient_hover.grad(m_game, m_size, 0x6060f0ff, 0x404080ff);
-    m_caption.m_label.text(m_game, "Winter-Strike", "BebasNeue.otf", 96, 0x404080ff);
+    m_caption.m_label = "Winter-Strike";
     m_caption.m_pos = m_pos - vec2i(0, 96);
 }
 
-void Menu::render(SDL_Renderer* renderer) {
+void Menu::render(SDL_Renderer* renderer, float alpha) {
     SDL_Rect rect = { 0, 0, 800, 600 };
+    m_game.getBatch().flush();
     SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 194);
     SDL_RenderFillRect(renderer, &rect);
 
-    m_caption.m_label.render(renderer, m_caption.m_pos);
+    m_caption_font->draw(m_caption.m_label, m_caption.m_pos, {0x40, 0x40, 0x80, 0xff});
 
     for (auto& button : m_buttons) {
         if (button.m_id == m_current) {
             m_gradient_hover.render(renderer, button.m_pos);
-            button.m_label.render(renderer, button.m_pos);
         }
         else {
             m_gradient_base.render(renderer, button.m_pos);
-            button.m_label.render(renderer, button.m_pos);
         }
+        m_button_font->draw(button.m_label, button.m_pos, {0xa0, 0xa0, 0xa0, 0xff});
     }
 }
 
@@ -97,7 +100,7 @@ void Menu::onEvent(SDL_Event& ev) {
 }
 
 void Menu::onSelect(int id) {
-    Mix_PlayChannel(-1, m_game.getSound("hit.ogg"), 0);
+    m_game.playSound("hit.ogg");
     m_game.popState(); // kill this state
 
     if (id == 0) {
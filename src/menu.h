@@ -18,20 +18,23 @@
 #define MENU_H
 
 #include <vector>
+#include <string>
 #include "state.h"
 #include "sprite.h"
 
+class GlyphAtlas;
+
 class Menu: public State {
 public:
     Menu(Game&);
-    void render(SDL_Renderer* renderer);
+    void render(SDL_Renderer* renderer, float alpha);
     void onEvent(SDL_Event& ev);
     void update(float dt);
 private:
     struct Button {
-        int    m_id;
-        Sprite m_label;
-        vec2i  m_pos;
+        int         m_id;
+        std::string m_label;
+        vec2i       m_pos;
     };
     int getButtonId(const vec2i& pos);
     void onSelect(int);
@@ -40,6 +43,8 @@ private:
     vec2i m_pos;
     vec2i m_size;
 
+    GlyphAtlas* m_caption_font;
+    GlyphAtlas* m_button_font;
     Button m_caption;
     Sprite m_gradient_base;
     Sprite m_gradient_hover;
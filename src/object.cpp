@@ -18,24 +18,57 @@
 #include <unordered_map>
 #include <SDL.h>
 #include "object.h"
+#include "objectpool.h"
+#include "world.h"
 
 int Object::max_object_id = 0;
 
-Object::Object(World& world, const std::string& classname, const vec2f& pos) :
+Object::Object(World& world, const char* classname, unsigned type, const vec2f& pos) :
     m_world(world),
+    m_entities(world.getEntities()),
     m_classname(classname),
     m_object_id(max_object_id++),
-    m_pos(pos),
-    m_z(2),
-    m_alive(true),
-    m_solid(true),
-    m_collider(true)
+    m_entity(m_entities.create(this, type, FLAG_SOLID | FLAG_COLLIDER, pos)),
+    m_pool(nullptr)
 {
-    SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Create %s  (object #%d)", m_classname.c_str(), m_object_id);
+    SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Create %s  (object #%d)", m_classname, m_object_id);
 }
 
 Object::~Object() {
-    SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Delete %s  (object #%d)", m_classname.c_str(), m_object_id);
+    retire();
+    SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Delete %s  (object #%d)", m_classname, m_object_id);
+}
+
+/**
+ * Leave the world, the object keeps its resources for a respawn
+ */
+void Object::retire() {
+    if (m_entity != Entities::NONE) {
+        m_entities.destroy(m_entity);
+        m_entity = Entities::NONE;
+    }
+}
+
+/**
+ * Enter the world again as a new object
+ */
+void Object::respawn(unsigned type, const vec2f& pos) {
+    retire();
+    m_object_id = max_object_id++;
+    m_entity = m_entities.create(this, type, FLAG_SOLID | FLAG_COLLIDER, pos);
+}
+
+void Object::setType(unsigned type) {
+    m_world.setType(*this, type);
+}
+
+void ObjectDeleter::operator()(Object* object) const {
+    if (object->getPool()) {
+        object->getPool()->release(object);
+    }
+    else {
+        delete object;
+    }
 }
 
 void Object::render(SDL_Renderer* renderer, const vec2i& screenCoords) {
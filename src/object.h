@@ -17,42 +17,79 @@
 #ifndef OBJECT_H
 #define OBJECT_H
 
-#include <string>
+#include <memory>
+#include "entities.h"
 #include "vec.h"
 
 class World;
+class ObjectPoolBase;
 struct SDL_Renderer;
 
+/**
+ * Behaviour of an entity. Its data lives in the world's entity arrays,
+ * the accessors below read and write them there.
+ */
 class Object {
 public:
-    Object(World& world, const std::string& className, const vec2f& pos = vec2f());
+    // categories, one bit each so filters test a mask with a single AND
+    enum Type {
+        TYPE_CHARACTER  = 1 << 0, // alive character of any side
+        TYPE_PLAYER     = 1 << 1,
+        TYPE_AI         = 1 << 2,
+        TYPE_PROJECTILE = 1 << 3,
+        TYPE_LABEL      = 1 << 4,
+        TYPE_CORPSE     = 1 << 5,
+    };
+    enum Flag {
+        FLAG_SOLID    = 1 << 0, // object blocks movement
+        FLAG_COLLIDER = 1 << 1, // object may collide with other objects
+    };
+
+    Object(World& world, const char* className, unsigned type, const vec2f& pos = vec2f());
     virtual ~Object();
 
     virtual void render(SDL_Renderer* renderer, const vec2i& screenCoords);
     virtual void update(float dt);
 
-    inline const std::string& getClassname() const {
+    // for logging only, test types instead
+    inline const char* getClassname() const {
         return m_classname;
     }
 
+    inline Entities::Id getEntity() const {
+        return m_entity;
+    }
+
+    inline unsigned getType() const {
+        return m_entities.getType(m_entity);
+    }
+
+    inline bool isType(unsigned mask) const {
+        return (getType() & mask) != 0;
+    }
+
+    inline unsigned getFlags() const {
+        return m_entities.getFlags(m_entity);
+    }
+
     inline const vec2f& getPosition() const {
-        return m_pos;
+        return m_entities.getPosition(m_entity);
     }
 
     inline const int getZ() const {
-        return m_z;
+        return m_entities.getZ(m_entity);
     }
 
     inline const bool isAlive() const {
-        return m_alive;
+        return (m_entities.getState(m_entity) & Entities::ALIVE) != 0;
     }
 
     inline const bool isSolid() const {
-        return m_solid;
+        return (getFlags() & FLAG_SOLID) != 0;
     }
 
     inline const bool isCollider() const {
-        return m_collider;
+        return (getFlags() & FLAG_COLLIDER) != 0;
     }
 
     inline const int getObjectId() const {
@@ -68,27 +105,99 @@ public:
     }
 
     inline void setPosition(const vec2f& pos) {
-        m_pos = pos;
+        m_entities.setPosition(m_entity, pos);
     }
 
     inline void setZ(int z) {
-        m_z = z;
+        m_entities.setZ(m_entity, z);
     }
 
     // events
     virtual void onCollision(Object* other);
     virtual void onHit(Object* other, int hp);
+
+    // pooled objects are retired instead of deleted, then reset in place
+    inline ObjectPoolBase* getPool() const {
+        return m_pool;
+    }
+
+    inline void setPool(ObjectPoolBase* pool) {
+        m_pool = pool;
+    }
+
+    void retire();
 protected:
+    void respawn(unsigned type, const vec2f& pos);
+
+    // applied later while objects update in parallel, see World::setType()
+    void setType(unsigned type);
+
+    inline void setFlags(unsigned flags) {
+        m_entities.setFlags(m_entity, flags);
+    }
+
+    inline void kill() {
+        m_entities.setState(m_entity, Entities::ALIVE, false);
+    }
+
+    // objects which only react to system events skip the update otherwise
+    inline void setThink(bool think) {
+        m_entities.setState(m_entity, Entities::THINK, think);
+    }
+
+    inline bool checkState(unsigned bits) const {
+        return (m_entities.getState(m_entity) & bits) != 0;
+    }
+
+    // moved by the motion system
+    inline const vec2f& getVelocity() const {
+        return m_entities.getVelocity(m_entity);
+    }
+
+    inline void setVelocity(const vec2f& vel) {
+        m_entities.setVelocity(m_entity, vel);
+    }
+
+    // advanced by the age system, Entities::EXPIRED is set after ttl seconds
+    inline float getAge() const {
+        return m_entities.getAge(m_entity);
+    }
+
+    inline float getTtl() const {
+        return m_entities.getTtl(m_entity);
+    }
+
+    inline void setTtl(float ttl) {
+        m_entities.setTtl(m_entity, ttl);
+    }
+
+    // advanced by the animation system, Entities::STOPPED is set at the end of one-shots
+    inline float getFrame() const {
+        return m_entities.getFrame(m_entity);
+    }
+
+    inline void setAnimation(Entities::Animation mode, int frames, float rate) {
+        m_entities.setAnimation(m_entity, mode, frames, rate);
+    }
+
     static int max_object_id;
 
-    World&      m_world;
-    std::string m_classname;
-    int         m_object_id;
-    vec2f       m_pos;
-    int         m_z;
-    bool        m_alive;
-    bool        m_solid;    // object blocks movement
-    bool        m_collider; // object may collide with other objects
-    int         m_owner_id;
+    World&          m_world;
+    Entities&       m_entities;
+    const char*     m_classname;
+    int             m_object_id;
+    Entities::Id    m_entity; // Entities::NONE while retired
+    int             m_owner_id;
+    ObjectPoolBase* m_pool;   // nullptr - not pooled
 };
+
+/**
+ * Returns pooled objects to their pool, deletes the others
+ */
+struct ObjectDeleter {
+    void operator()(Object* object) const;
+};
+
+typedef std::unique_ptr<Object, ObjectDeleter> ObjectPtr;
+
 #endif
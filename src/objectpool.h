@@ -0,0 +1,96 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+class Object;
+class World;
+
+/**
+ * Where dead pooled objects go back to, see ObjectDeleter
+ */
+class ObjectPoolBase {
+public:
+    struct Stats {
+        size_t        m_size;        // objects allocated
+        size_t        m_used;        // objects in the world
+        size_t        m_peak;        // max objects in the world at once
+        unsigned long m_acquires;
+        unsigned long m_allocations; // acquires which had to allocate
+    };
+
+    virtual ~ObjectPoolBase() {}
+    virtual void release(Object* object) = 0;
+
+    inline const Stats& getStats() const {
+        return m_stats;
+    }
+
+protected:
+    ObjectPoolBase() : m_stats() {}
+
+    Stats m_stats;
+};
+
+/**
+ * Free list of objects of one type. Released objects drop their entity
+ * and stay constructed, reuse resets them in place with T::reset(),
+ * which takes the constructor arguments after the world.
+ */
+template <typename T>
+class ObjectPool: public ObjectPoolBase {
+public:
+    template <typename... Args>
+    T* acquire(World& world, Args&&... args) {
+        T* object;
+
+        if (m_free.empty()) {
+            m_objects.push_back(std::make_unique<T>(world, std::forward<Args>(args)...));
+            object = m_objects.back().get();
+            object->setPool(this);
+            m_free.reserve(m_objects.size());
+            m_stats.m_size++;
+            m_stats.m_allocations++;
+        }
+        else {
+            object = m_free.back();
+            m_free.pop_back();
+            object->reset(std::forward<Args>(args)...);
+        }
+        m_stats.m_acquires++;
+        m_stats.m_used++;
+        m_stats.m_peak = std::max(m_stats.m_peak, m_stats.m_used);
+        return object;
+    }
+
+    void release(Object* object) {
+        object->retire();
+        m_free.push_back(static_cast<T*>(object));
+        m_stats.m_used--;
+    }
+
+private:
+    std::vector<std::unique_ptr<T>> m_objects;
+    std::vector<T*> m_free;
+};
+
+#endif
@@ -0,0 +1,60 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "pathfinder.h"
+
+Pathfinder::Pathfinder(unsigned budget) :
+    m_generation(0),
+    m_budget(std::max(1u, budget)),
+    m_stats()
+{
+}
+
+/**
+ * Center the grid on the start, nodes of earlier searches become stale
+ */
+void Pathfinder::begin(const vec2i& start) {
+    if (m_nodes.empty()) {
+        m_nodes.resize(SIDE * SIDE, Node());
+        m_heap.reserve(SIDE * 4);
+    }
+
+    // stamps start over once in 4G searches
+    if (++m_generation == 0) {
+        for (auto& node : m_nodes) {
+            node.m_stamp = 0;
+        }
+        m_generation = 1;
+    }
+    m_origin = start - vec2i(RADIUS, RADIUS);
+    m_heap.clear();
+}
+
+/**
+ * Collect waypoints back from the last node
+ */
+void Pathfinder::end(uint32_t last, bool found, unsigned expanded, std::vector<vec2f>& path) {
+    path.clear();
+    for (uint32_t index = last; m_nodes[index].m_parent != index; index = m_nodes[index].m_parent) {
+        path.push_back((vec2f)getPos(index));
+    }
+
+    m_stats.m_searches++;
+    m_stats.m_expanded += expanded;
+    if (!found) {
+        m_stats.m_partial++;
+    }
+}
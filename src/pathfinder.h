@@ -0,0 +1,198 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef PATHFINDER_H
+#define PATHFINDER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include "vec.h"
+
+/**
+ * A* over the tiles around the start of a search. Nodes live in a flat grid
+ * reused by every search, a node is reset on first touch when its stamp is
+ * older than the search. Searches expand at most the budget of nodes, after
+ * that the path leads to the closest tile found.
+ */
+class Pathfinder {
+public:
+    enum { RADIUS = 64, BUDGET = 1024 }; // search area is 2 * RADIUS + 1 tiles wide
+
+    struct Stats {
+        unsigned long m_searches;
+        unsigned long m_expanded; // nodes over all searches
+        unsigned long m_partial;  // searches which did not reach the goal
+    };
+
+    explicit Pathfinder(unsigned budget = BUDGET);
+
+    inline void setBudget(unsigned nodes) {
+        m_budget = std::max(1u, nodes);
+    }
+
+    inline unsigned getBudget() const {
+        return m_budget;
+    }
+
+    inline const Stats& getStats() const {
+        return m_stats;
+    }
+
+    // waypoints in reverse order without the start, false if the goal was not reached
+    template <typename Passable>
+    bool find(const vec2i& start, const vec2i& goal, Passable passable, std::vector<vec2f>& path);
+private:
+    enum { SIDE = 2 * RADIUS + 1 };
+    enum { KNOWN = 1, PASSABLE = 2, CLOSED = 4 }; // node state bits
+
+    struct Node {
+        uint32_t m_stamp;  // generation of the search which touched it last
+        int32_t  m_cost;   // from the start, 1000 per straight step
+        uint32_t m_parent;
+        uint8_t  m_state;
+    };
+    // open list entry, stale ones are skipped when their node is closed
+    struct Entry {
+        uint64_t m_key; // cost + heuristic, then heuristic to prefer nodes closer to the goal
+        uint32_t m_node;
+    };
+
+    static inline uint64_t getKey(int cost, int heuristic) {
+        return uint64_t(cost + heuristic) << 32 | uint32_t(heuristic);
+    }
+
+    // 8-direction move cost estimate
+    static inline int heuristic(const vec2i& v) {
+        int dx = std::abs(v.x), dy = std::abs(v.y);
+        return (dx > dy) ? (1000 * dx + 414 * dy) : (1000 * dy + 414 * dx);
+    }
+
+    static inline bool later(const Entry& a, const Entry& b) {
+        return a.m_key > b.m_key;
+    }
+
+    inline vec2i getPos(uint32_t index) const {
+        return m_origin + vec2i(int(index % SIDE), int(index / SIDE));
+    }
+
+    inline Node& touch(uint32_t index) {
+        Node& node = m_nodes[index];
+        if (node.m_stamp != m_generation) {
+            node.m_stamp = m_generation;
+            node.m_cost = INT32_MAX;
+            node.m_state = 0;
+        }
+        return node;
+    }
+
+    // tiles are tested once per search
+    template <typename Passable>
+    inline bool isPassable(uint32_t index, Passable& passable) {
+        Node& node = touch(index);
+        if (!(node.m_state & KNOWN)) {
+            node.m_state |= KNOWN | (passable(getPos(index)) ? PASSABLE : 0);
+        }
+        return (node.m_state & PASSABLE) != 0;
+    }
+
+    void begin(const vec2i& start);
+    void end(uint32_t last, bool found, unsigned expanded, std::vector<vec2f>& path);
+
+    std::vector<Node>  m_nodes; // SIDE x SIDE, allocated by the first search
+    std::vector<Entry> m_heap;
+    uint32_t m_generation;
+    vec2i    m_origin;          // map position of node 0
+    unsigned m_budget;          // max nodes expanded per search
+    Stats    m_stats;
+};
+
+template <typename Passable>
+bool Pathfinder::find(const vec2i& start, const vec2i& goal, Passable passable, std::vector<vec2f>& path) {
+    static const int dx[] = {0, -1, +1, 0, -1, +1, -1, +1};
+    static const int dy[] = {-1, 0, 0, +1, -1, -1, +1, +1};
+    static const int weights[] = {1000, 1000, 1000, 1000, 1414, 1414, 1414, 1414}; // M_SQRT2
+
+    begin(start);
+
+    uint32_t first = RADIUS * SIDE + RADIUS;
+    Node& root = touch(first);
+    root.m_cost = 0;
+    root.m_parent = first;
+
+    uint32_t best = first;
+    int best_heuristic = heuristic(start - goal);
+    unsigned expanded = 0;
+    bool found = false;
+
+    m_heap.push_back({getKey(0, best_heuristic), first});
+
+    while (!m_heap.empty() && expanded < m_budget) {
+        std::pop_heap(m_heap.begin(), m_heap.end(), later);
+        uint32_t current = m_heap.back().m_node;
+        m_heap.pop_back();
+
+        Node& node = m_nodes[current];
+        if (node.m_state & CLOSED) {
+            continue;
+        }
+        node.m_state |= CLOSED;
+        expanded++;
+
+        vec2i pos = getPos(current);
+        if (pos == goal) {
+            best = current;
+            found = true;
+            break;
+        }
+        // remember node closest to the goal in case we can't reach it
+        int h = heuristic(pos - goal);
+        if (h < best_heuristic || (h == best_heuristic && node.m_cost < m_nodes[best].m_cost)) {
+            best = current;
+            best_heuristic = h;
+        }
+
+        int x = int(current % SIDE), y = int(current / SIDE);
+        for (int i = 0; i < 8; ++i) {
+            int nx = x + dx[i], ny = y + dy[i];
+            if (nx < 0 || ny < 0 || nx >= SIDE || ny >= SIDE) {
+                continue;
+            }
+            uint32_t index = uint32_t(ny * SIDE + nx);
+            Node& next = touch(index);
+
+            // allow diagonal movement only if adjacent tiles are passable
+            if ((next.m_state & CLOSED) || !isPassable(index, passable) ||
+                (i > 3 && (!isPassable(uint32_t(y * SIDE + nx), passable) || !isPassable(uint32_t(ny * SIDE + x), passable)))) {
+                continue;
+            }
+
+            int cost = node.m_cost + weights[i];
+            if (cost < next.m_cost) {
+                next.m_cost = cost;
+                next.m_parent = current;
+                m_heap.push_back({getKey(cost, heuristic(getPos(index) - goal)), index});
+                std::push_heap(m_heap.begin(), m_heap.end(), later);
+            }
+        }
+    }
+
+    end(best, found, expanded, path);
+    return found;
+}
+
+#endif
@@ -0,0 +1,81 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+
+/**
+ * xoshiro128** generator, small and fast enough for a stream per object.
+ * Meets UniformRandomBitGenerator, so it works with std::shuffle and <random>.
+ */
+class Random {
+public:
+    typedef uint32_t result_type;
+
+    explicit Random(uint64_t seed = 0) {
+        // splitmix64 spreads the seed, an all zero state can't come out of it
+        for (int i = 0; i < 4; i += 2) {
+            uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            z ^= z >> 31;
+            m_state[i] = uint32_t(z);
+            m_state[i + 1] = uint32_t(z >> 32);
+        }
+    }
+
+    static constexpr result_type min() {
+        return 0;
+    }
+
+    static constexpr result_type max() {
+        return UINT32_MAX;
+    }
+
+    inline result_type operator()() {
+        uint32_t result = rotl(m_state[1] * 5, 7) * 9;
+        uint32_t t = m_state[1] << 9;
+
+        m_state[2] ^= m_state[0];
+        m_state[3] ^= m_state[1];
+        m_state[1] ^= m_state[2];
+        m_state[0] ^= m_state[3];
+        m_state[2] ^= t;
+        m_state[3] = rotl(m_state[3], 11);
+        return result;
+    }
+
+    // uniform in [0, n)
+    inline uint32_t below(uint32_t n) {
+        return uint32_t((uint64_t((*this)()) * n) >> 32);
+    }
+
+    // independent stream seeded from this one
+    inline Random fork() {
+        uint64_t seed = uint64_t((*this)()) << 32;
+        return Random(seed | (*this)());
+    }
+private:
+    static inline uint32_t rotl(uint32_t x, int k) {
+        return (x << k) | (x >> (32 - k));
+    }
+
+    uint32_t m_state[4];
+};
+
+#endif
@@ -0,0 +1,115 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cmath>
+#include "object.h"
+#include "sprite.h"
+#include "renderqueue.h"
+
+RenderQueue::RenderQueue() :
+    m_next(0)
+{
+}
+
+/**
+ * Layer is the most significant part of a key
+ */
+uint64_t RenderQueue::getLayerKey(int layer) {
+    return uint64_t(std::min(std::max(layer, 0), 0xff)) << 56;
+}
+
+/**
+ * Tiles of one row go before objects and are grouped by sprite for batching
+ */
+uint64_t RenderQueue::getTileKey(int layer, const vec2i& pos, int sprite_id) {
+    uint64_t row = uint64_t(pos.x + pos.y + (1 << 23)) & 0xffffff;
+    return getLayerKey(layer) | row << 32 | uint64_t(KIND_TILE) << 31 | (uint64_t(sprite_id) & 0x7fffffff);
+}
+
+/**
+ * Objects are ordered by exact depth inside their row, then by submission order
+ */
+uint64_t RenderQueue::getObjectKey(int layer, const vec2f& pos, unsigned seq) {
+    float depth = pos.x + pos.y;
+    int   row = (int)std::round(depth);
+    uint64_t fine = uint64_t(std::min(std::max(depth - row + 0.5f, 0.0f), 1.0f) * 0x7fff);
+
+    return getLayerKey(layer) | (uint64_t(row + (1 << 23)) & 0xffffff) << 32 | uint64_t(KIND_OBJECT) << 31 | fine << 16 | (seq & 0xffff);
+}
+
+void RenderQueue::push(uint64_t key, const Sprite* sprite, const vec2i& screen_pos) {
+    m_commands.push_back(Command{key, sprite, nullptr, screen_pos});
+}
+
+void RenderQueue::push(uint64_t key, Object* object, const vec2i& screen_pos) {
+    m_commands.push_back(Command{key, nullptr, object, screen_pos});
+}
+
+/**
+ * Stable LSD radix sort by key bytes
+ */
+void RenderQueue::sort() {
+    if (m_commands.empty()) {
+        return;
+    }
+    m_scratch.resize(m_commands.size());
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t count[256] = {};
+
+        for (auto& command : m_commands) {
+            count[(command.m_key >> shift) & 0xff]++;
+        }
+        // all keys share this byte, the pass would not change the order
+        if (count[(m_commands[0].m_key >> shift) & 0xff] == m_commands.size()) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (auto& n : count) {
+            size_t bucket = n;
+            n = offset;
+            offset += bucket;
+        }
+        for (auto& command : m_commands) {
+            m_scratch[count[(command.m_key >> shift) & 0xff]++] = command;
+        }
+        m_commands.swap(m_scratch);
+    }
+}
+
+/**
+ * Draw sorted commands with keys below the end key.
+ * Drawing continues from there on the next call.
+ */
+void RenderQueue::render(SDL_Renderer* renderer, uint64_t end) {
+    for (; m_next < m_commands.size() && m_commands[m_next].m_key < end; ++m_next) {
+        const Command& command = m_commands[m_next];
+
+        if (command.m_sprite) {
+            command.m_sprite->render(renderer, command.m_pos, 0, 0);
+        }
+        else {
+            command.m_object->render(renderer, command.m_pos);
+        }
+    }
+}
+
+void RenderQueue::clear() {
+    m_commands.clear();
+    m_next = 0;
+}
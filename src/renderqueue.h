@@ -0,0 +1,66 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <cstdint>
+#include <vector>
+#include "vec.h"
+
+struct SDL_Renderer;
+class Sprite;
+class Object;
+
+/**
+ * Draw commands ordered by a packed 64-bit key:
+ * layer (8 bits), depth row (24 bits), kind (1 bit) and 31 bits of kind
+ * specific order - sprite id for tiles, sub-row depth for objects.
+ * Keys are sorted with a byte-wise radix sort, bytes equal in all keys are skipped.
+ */
+class RenderQueue {
+public:
+    enum Kind { KIND_TILE, KIND_OBJECT };
+
+    RenderQueue();
+
+    static uint64_t getTileKey(int layer, const vec2i& pos, int sprite_id);
+    static uint64_t getObjectKey(int layer, const vec2f& pos, unsigned seq);
+    static uint64_t getLayerKey(int layer);
+
+    void push(uint64_t key, const Sprite* sprite, const vec2i& screen_pos);
+    void push(uint64_t key, Object* object, const vec2i& screen_pos);
+    void sort();
+    void render(SDL_Renderer*, uint64_t end = UINT64_MAX);
+    void clear();
+
+    inline size_t size() const {
+        return m_commands.size();
+    }
+private:
+    struct Command {
+        uint64_t      m_key;
+        const Sprite* m_sprite; // either a tile sprite
+        Object*       m_object; // or an object
+        vec2i         m_pos;
+    };
+
+    std::vector<Command> m_commands;
+    std::vector<Command> m_scratch;
+    size_t m_next; // first command not rendered yet
+};
+
+#endif
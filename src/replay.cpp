@@ -0,0 +1,138 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <stdexcept>
+#include <SDL.h>
+#include "game.h"
+#include "replay.h"
+
+static const char MAGIC[4] = {'W', 'S', 'R', 'P'};
+
+Replay::Replay() :
+    m_file(nullptr),
+    m_recording(false),
+    m_seed(0),
+    m_step_rate(0),
+    m_pending(),
+    m_has_pending(false)
+{
+}
+
+Replay::~Replay() {
+    close();
+}
+
+/**
+ * Start recording, an existing file is overwritten
+ */
+void Replay::create(const std::string& fileName, int seed, int stepRate) {
+    close();
+
+    if ((m_file = SDL_RWFromFile(fileName.c_str(), "wb")) == nullptr) {
+        throw std::runtime_error(SDL_GetError());
+    }
+    m_recording = true;
+    m_seed = seed;
+    m_step_rate = stepRate;
+
+    if (SDL_RWwrite(m_file, MAGIC, sizeof(MAGIC), 1) != 1 || SDL_WriteLE32(m_file, VERSION) == 0 ||
+        SDL_WriteLE32(m_file, Uint32(seed)) == 0 || SDL_WriteLE32(m_file, Uint32(stepRate)) == 0) {
+        throw std::runtime_error(SDL_GetError());
+    }
+    SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Record replay: %s (seed %d)", fileName.c_str(), seed);
+}
+
+/**
+ * Open a recording for playback
+ */
+void Replay::open(const std::string& fileName) {
+    char magic[sizeof(MAGIC)];
+
+    close();
+
+    if ((m_file = SDL_RWFromFile(fileName.c_str(), "rb")) == nullptr) {
+        throw std::runtime_error(SDL_GetError());
+    }
+    if (SDL_RWread(m_file, magic, sizeof(magic), 1) != 1 || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        SDL_ReadLE32(m_file) != VERSION) {
+        close();
+        throw std::runtime_error("Not a replay: " + fileName);
+    }
+    m_seed = int(SDL_ReadLE32(m_file));
+    m_step_rate = int(SDL_ReadLE32(m_file));
+
+    // the game steps at the recorded rate, it must be one -r accepts
+    if (m_step_rate < Game::MIN_STEP_RATE || m_step_rate > Game::MAX_STEP_RATE) {
+        close();
+        throw std::runtime_error("Not a replay: " + fileName);
+    }
+    m_has_pending = read(m_pending);
+    SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Play replay: %s (seed %d)", fileName.c_str(), m_seed);
+}
+
+void Replay::close() {
+    if (m_file) {
+        SDL_RWclose(m_file);
+        m_file = nullptr;
+    }
+    m_recording = false;
+    m_has_pending = false;
+}
+
+/**
+ * Append an action, 13 bytes each
+ */
+void Replay::write(const Record& record) {
+    Uint32 x, y;
+    std::memcpy(&x, &record.m_pos.x, sizeof(x));
+    std::memcpy(&y, &record.m_pos.y, sizeof(y));
+
+    if (SDL_WriteLE32(m_file, record.m_frame) == 0 || SDL_WriteU8(m_file, record.m_action) == 0 ||
+        SDL_WriteLE32(m_file, x) == 0 || SDL_WriteLE32(m_file, y) == 0) {
+        throw std::runtime_error(SDL_GetError());
+    }
+}
+
+/**
+ * Get the next action due before the update of the frame, false if there is none
+ */
+bool Replay::next(uint32_t frame, Record& record) {
+    if (!m_has_pending || m_pending.m_frame > frame) {
+        return false;
+    }
+    record = m_pending;
+    m_has_pending = read(m_pending);
+    return true;
+}
+
+bool Replay::read(Record& record) {
+    Uint8 action;
+    Uint32 frame, x, y;
+
+    // a truncated record ends the replay
+    if (SDL_RWread(m_file, &frame, sizeof(frame), 1) != 1 || SDL_RWread(m_file, &action, sizeof(action), 1) != 1 ||
+        SDL_RWread(m_file, &x, sizeof(x), 1) != 1 || SDL_RWread(m_file, &y, sizeof(y), 1) != 1) {
+        return false;
+    }
+    record.m_frame = SDL_SwapLE32(frame);
+    record.m_action = action;
+    x = SDL_SwapLE32(x);
+    y = SDL_SwapLE32(y);
+    std::memcpy(&record.m_pos.x, &x, sizeof(x));
+    std::memcpy(&record.m_pos.y, &y, sizeof(y));
+    return true;
+}
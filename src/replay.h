@@ -0,0 +1,78 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <string>
+#include <cstdint>
+#include "vec.h"
+
+struct SDL_RWops;
+
+/**
+ * Player actions of a world in a binary file, with the seed and the step
+ * rate. Actions are stored with the update they happened before, so a world
+ * of the same seed playing them back repeats the game frame for frame.
+ */
+class Replay {
+public:
+    enum Action { WALK = 1, THROW = 2, CHECK = 3 }; // a check holds World::getChecksum()
+
+    struct Record {
+        uint32_t m_frame;
+        uint8_t  m_action;
+        vec2f    m_pos;
+    };
+
+    Replay();
+    ~Replay();
+
+    Replay(const Replay&) = delete;
+    Replay& operator=(const Replay&) = delete;
+
+    void create(const std::string& fileName, int seed, int stepRate);
+    void open(const std::string& fileName);
+    void close();
+
+    void write(const Record& record);
+    bool next(uint32_t frame, Record& record);
+
+    inline bool isRecording() const {
+        return m_recording;
+    }
+
+    inline int getSeed() const {
+        return m_seed;
+    }
+
+    inline int getStepRate() const {
+        return m_step_rate;
+    }
+private:
+    enum { VERSION = 1 };
+
+    bool read(Record& record);
+
+    SDL_RWops* m_file;
+    bool       m_recording;
+    int        m_seed;
+    int        m_step_rate;
+    Record     m_pending; // read ahead while playing
+    bool       m_has_pending;
+};
+
+#endif
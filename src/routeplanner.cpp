@@ -0,0 +1,82 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "routeplanner.h"
+
+RoutePlanner::RoutePlanner() :
+    m_generation(0),
+    m_stats()
+{
+}
+
+/**
+ * Center the window on the chunk of the start, areas of earlier searches become stale
+ */
+void RoutePlanner::begin(const vec2i& chunk_pos) {
+    if (m_areas.empty()) {
+        m_areas.resize(SIDE * SIDE, Area());
+    }
+
+    // stamps start over once in 4G searches
+    if (++m_generation == 0) {
+        for (auto& area : m_areas) {
+            area.m_stamp = 0;
+        }
+        m_generation = 1;
+    }
+    m_origin = chunk_pos - vec2i(RADIUS, RADIUS) * SIZE;
+    m_nodes.clear();
+    m_heap.clear();
+}
+
+/**
+ * Reach an entrance cheaper
+ */
+void RoutePlanner::relax(uint32_t area, unsigned entrance, int cost, uint32_t parent, const vec2i& goal) {
+    uint32_t index = m_areas[area].m_first + entrance;
+    Node& node = m_nodes[index];
+
+    if (!node.m_closed && cost < node.m_cost) {
+        node.m_cost = cost;
+        node.m_parent = parent;
+        m_heap.push_back({getKey(cost, estimate(getPos(node) - goal)), index});
+        std::push_heap(m_heap.begin(), m_heap.end(), later);
+    }
+}
+
+/**
+ * Collect entrances back from the last one. An entrance left through is
+ * dropped, the path to the entrance across leads through it anyway.
+ */
+void RoutePlanner::end(uint32_t last, const vec2i& goal, unsigned expanded, std::vector<vec2f>& route) {
+    route.clear();
+
+    if (last != NONE) {
+        route.push_back((vec2f)goal);
+
+        for (uint32_t index = last, next = NONE; index != NONE; next = index, index = m_nodes[index].m_parent) {
+            if (next == NONE || m_nodes[next].m_area == m_nodes[index].m_area) {
+                route.push_back((vec2f)getPos(m_nodes[index]));
+            }
+        }
+    }
+
+    m_stats.m_searches++;
+    m_stats.m_expanded += expanded;
+    if (last == NONE) {
+        m_stats.m_failed++;
+    }
+}
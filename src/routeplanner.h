@@ -0,0 +1,236 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ROUTEPLANNER_H
+#define ROUTEPLANNER_H
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include "chunkgraph.h"
+#include "vec.h"
+
+/**
+ * Long range search over the graphs of chunks around the start (HPA*).
+ * Routes lead from one chunk entrance to another, each step of a route is
+ * found on the tiles by a Pathfinder once the previous one is walked.
+ * Entrances are linked to the start and the goal by the straight distance,
+ * which is only checked to be within the same region of the chunk.
+ */
+class RoutePlanner {
+public:
+    enum { RADIUS = 8, BUDGET = 4096 }; // chunks around the start, max entrances expanded
+
+    struct Stats {
+        unsigned long m_searches;
+        unsigned long m_expanded; // entrances over all searches
+        unsigned long m_failed;   // searches which did not reach the goal
+    };
+
+    RoutePlanner();
+
+    inline const Stats& getStats() const {
+        return m_stats;
+    }
+
+    // entrances to walk through in reverse order, the goal first, false if there is no route.
+    // Graphs of chunks which are not known are null.
+    template <typename GetGraph>
+    bool find(const vec2i& start, const vec2i& goal, GetGraph getGraph, std::vector<vec2f>& route);
+private:
+    enum { SIDE = 2 * RADIUS + 1, SIZE = ChunkGraph::SIZE };
+    enum { STEP = 1000 }; // cost of crossing a border
+    static const uint32_t NONE = UINT32_MAX;
+
+    // chunk in the search window, its nodes are allocated on first touch
+    struct Area {
+        uint32_t          m_stamp;
+        uint32_t          m_first;
+        const ChunkGraph* m_graph;
+    };
+    // entrance of a chunk
+    struct Node {
+        int32_t  m_cost;
+        uint32_t m_parent;
+        uint16_t m_area;
+        uint16_t m_entrance;
+        bool     m_closed;
+    };
+    struct Entry {
+        uint64_t m_key; // cost + heuristic, then heuristic
+        uint32_t m_node;
+    };
+
+    static inline uint64_t getKey(int cost, int heuristic) {
+        return uint64_t(cost + heuristic) << 32 | uint32_t(heuristic);
+    }
+
+    static inline int heuristic(const vec2i& v) {
+        int dx = std::abs(v.x), dy = std::abs(v.y);
+        return (dx > dy) ? (1000 * dx + 414 * dy) : (1000 * dy + 414 * dx);
+    }
+
+    // searches are guided by a quarter longer estimate, routes are a few
+    // percent longer, but found expanding several times fewer entrances
+    static inline int estimate(const vec2i& v) {
+        return heuristic(v) * 5 / 4;
+    }
+
+    static inline bool later(const Entry& a, const Entry& b) {
+        return a.m_key > b.m_key;
+    }
+
+    static inline vec2i getChunkPos(const vec2i& pos) {
+        return vec2i(pos.x & -SIZE, pos.y & -SIZE);
+    }
+
+    inline vec2i getAreaPos(uint32_t area) const {
+        return m_origin + vec2i(int(area % SIDE), int(area / SIDE)) * SIZE;
+    }
+
+    inline vec2i getPos(const Node& node) const {
+        return getAreaPos(node.m_area) + m_areas[node.m_area].m_graph->getEntrance(node.m_entrance).m_pos;
+    }
+
+    // area of a chunk, NONE if out of the window or not known
+    template <typename GetGraph>
+    uint32_t getArea(const vec2i& chunk_pos, GetGraph& getGraph);
+
+    void begin(const vec2i& chunk_pos);
+    void relax(uint32_t area, unsigned entrance, int cost, uint32_t parent, const vec2i& goal);
+    void end(uint32_t last, const vec2i& goal, unsigned expanded, std::vector<vec2f>& route);
+
+    std::vector<Area>  m_areas; // SIDE x SIDE, allocated by the first search
+    std::vector<Node>  m_nodes;
+    std::vector<Entry> m_heap;
+    uint32_t m_generation;
+    vec2i    m_origin;          // chunk of area 0
+    Stats    m_stats;
+};
+
+template <typename GetGraph>
+uint32_t RoutePlanner::getArea(const vec2i& chunk_pos, GetGraph& getGraph) {
+    vec2i index = (chunk_pos - m_origin) / SIZE;
+    if (index.x < 0 || index.y < 0 || index.x >= SIDE || index.y >= SIDE) {
+        return NONE;
+    }
+
+    uint32_t area = uint32_t(index.y * SIDE + index.x);
+    Area& record = m_areas[area];
+    if (record.m_stamp != m_generation) {
+        record.m_stamp = m_generation;
+        record.m_first = uint32_t(m_nodes.size());
+        record.m_graph = getGraph(chunk_pos);
+
+        size_t count = record.m_graph ? record.m_graph->size() : 0;
+        for (size_t i = 0; i < count; ++i) {
+            m_nodes.push_back({INT32_MAX, NONE, uint16_t(area), uint16_t(i), false});
+        }
+    }
+    return record.m_graph ? area : NONE;
+}
+
+template <typename GetGraph>
+bool RoutePlanner::find(const vec2i& start, const vec2i& goal, GetGraph getGraph, std::vector<vec2f>& route) {
+    vec2i start_chunk = getChunkPos(start), goal_chunk = getChunkPos(goal);
+    begin(start_chunk);
+
+    uint32_t first = getArea(start_chunk, getGraph);
+    uint32_t last = getArea(goal_chunk, getGraph);
+    if (first == NONE || last == NONE) {
+        end(NONE, goal, 0, route);
+        return false;
+    }
+
+    // regions without entrances can't be left or entered
+    unsigned start_region = m_areas[first].m_graph->getRegion(start - start_chunk);
+    unsigned goal_region = m_areas[last].m_graph->getRegion(goal - goal_chunk);
+    if (start_region == ChunkGraph::NO_REGION || goal_region == ChunkGraph::NO_REGION) {
+        end(NONE, goal, 0, route);
+        return false;
+    }
+
+    // the Pathfinder does without a route
+    if (first == last && start_region == goal_region) {
+        route.assign(1, (vec2f)goal);
+        m_stats.m_searches++;
+        return true;
+    }
+
+    const ChunkGraph& start_graph = *m_areas[first].m_graph;
+    for (unsigned i = 0; i < start_graph.size(); ++i) {
+        if (start_graph.getEntrance(i).m_region == start_region) {
+            relax(first, i, heuristic(start_chunk + start_graph.getEntrance(i).m_pos - start), NONE, goal);
+        }
+    }
+
+    uint32_t best = NONE;  // entrance the goal is reached from
+    int best_cost = INT_MAX;
+    unsigned expanded = 0;
+
+    while (!m_heap.empty() && expanded < BUDGET) {
+        std::pop_heap(m_heap.begin(), m_heap.end(), later);
+        Entry entry = m_heap.back();
+        m_heap.pop_back();
+
+        // nothing left which could lead to the goal cheaper
+        if (int(entry.m_key >> 32) >= best_cost) {
+            break;
+        }
+        Node& node = m_nodes[entry.m_node];
+        if (node.m_closed) {
+            continue;
+        }
+        node.m_closed = true;
+        expanded++;
+
+        uint32_t area = node.m_area;
+        unsigned entrance = node.m_entrance;
+        int cost = node.m_cost;
+        const ChunkGraph& graph = *m_areas[area].m_graph;
+        vec2i pos = getPos(node);
+
+        if (area == last && graph.getEntrance(entrance).m_region == goal_region) {
+            int total = cost + heuristic(goal - pos);
+            if (total < best_cost) {
+                best_cost = total;
+                best = entry.m_node;
+            }
+        }
+
+        // other entrances of the chunk
+        for (unsigned i = 0; i < graph.size(); ++i) {
+            int step = graph.getCost(entrance, i);
+            if (i != entrance && step != ChunkGraph::NO_PATH) {
+                relax(area, i, cost + step, entry.m_node, goal);
+            }
+        }
+
+        // and across the border, areas may add nodes
+        vec2i across = getAreaPos(area) + ChunkGraph::STEPS[graph.getEntrance(entrance).m_side] * SIZE;
+        uint32_t next = getArea(across, getGraph);
+        if (next != NONE) {
+            relax(next, graph.getCounterpart(entrance, *m_areas[next].m_graph), cost + STEP, entry.m_node, goal);
+        }
+    }
+
+    end(best, goal, expanded, route);
+    return best != NONE;
+}
+
+#endif
@@ -22,55 +22,65 @@
 #include "snowball.h"
 
 Snowball::Snowball(World& world, const vec2f& pos, const vec2f& dir, int owner_id) :
-    Object(world, "Snowball", pos),
-    m_dir(dir),
-    m_state(SNOWBALL),
-    m_frame(0),
+    Object(world, "Snowball", TYPE_PROJECTILE, pos),
     m_speed(16),
     m_height(64),
-    m_ttl(1)
+    m_sprites(world.getGame().getSprites(Game::SPRITE_SNOWBALL))
 {
-    m_sprites.resize(3);
-    m_sprites[SHADOW  ].load(m_world.getGame(), "snowball.png", vec2i(64, 64), vec2i(32, 12), 0, 1);
-    m_sprites[SNOWBALL].load(m_world.getGame(), "snowball.png", vec2i(64, 64), vec2i(32, 12), 1, 1);
-    m_sprites[EXPLODE ].load(m_world.getGame(), "snowball.png", vec2i(64, 64), vec2i(32, 12), 1, 8);
+    launch(dir, owner_id);
+}
+
+/**
+ * Throw a pooled snowball again
+ */
+void Snowball::reset(const vec2f& pos, const vec2f& dir, int owner_id) {
+    respawn(TYPE_PROJECTILE, pos);
+    launch(dir, owner_id);
+}
 
-    m_solid = false;
+void Snowball::launch(const vec2f& dir, int owner_id) {
+    m_dir = dir;
+    m_state = SNOWBALL;
     m_owner_id = owner_id;
+
+    setFlags(FLAG_COLLIDER);
+    setVelocity(m_dir * m_speed);
+    setTtl(1);
+    setThink(false); // flies on its own until it expires or hits
 }
 
 void Snowball::render(SDL_Renderer* renderer, const vec2i& pos) {
     if (m_state == SNOWBALL) {
         m_sprites[SHADOW].render(renderer, vec2i(pos.x, floor(pos.y)), 0, 0);
     }
-    m_sprites[m_state].render(renderer, vec2i(pos.x, floor(pos.y - m_height)), 0, (int)m_frame);
+    m_sprites[m_state].render(renderer, vec2i(pos.x, floor(pos.y - m_height)), 0, (int)getFrame());
 }
 
+/**
+ * Called when the flight time is over or the explosion has played
+ */
 void Snowball::update(float dt) {
-    if (m_state == SNOWBALL) {
-        m_pos += m_dir * m_speed * dt;
-        m_ttl -= dt;
-        if (m_ttl < 0) {
-            m_state = EXPLODE;
-        }
+    if (m_state == SNOWBALL && checkState(Entities::EXPIRED)) {
+        explode();
     }
-    else if (m_state == EXPLODE) {
-        m_frame += 8 * dt;
-        if (m_frame >= m_sprites[m_state].getFrames()) {
-            m_frame = 0;
-            m_alive = false;
-        }
+    else if (m_state == EXPLODE && checkState(Entities::STOPPED)) {
+        kill();
     }
 }
 
+void Snowball::explode() {
+    m_state = EXPLODE;
+    setVelocity(vec2f());
+    setAnimation(Entities::ANIM_ONCE, m_sprites[EXPLODE].getFrames(), 8);
+}
+
 void Snowball::onCollision(Object* other) {
     // check owner so we don't get hit by own projectiles
     if (m_state == SNOWBALL && (other == nullptr || other->getObjectId() != m_owner_id)) {
-        m_state = EXPLODE;
-        m_solid = false;
-        m_collider = false;
+        explode();
+        setFlags(0);
 
-        if (Mix_PlayChannel(-1, m_world.getGame().getSound("hit.ogg"), 0) < 0) {
+        if (!m_world.getGame().playSound("hit.ogg")) {
             throw std::runtime_error(Mix_GetError());
         }
         if (other) {
@@ -17,7 +17,6 @@
 #ifndef SNOWBALL_H
 #define SNOWBALL_H
 
-#include <vector>
 #include "object.h"
 #include "sprite.h"
 
@@ -26,19 +25,21 @@ public:
     enum { SHADOW, SNOWBALL, EXPLODE };
 
     Snowball(World& world, const vec2f& pos, const vec2f& dir, int owner);
+    void reset(const vec2f& pos, const vec2f& dir, int owner);
 
     void render(SDL_Renderer* renderer, const vec2i& pos);
     void update(float dt);
 
     void onCollision(Object* other);
 private:
+    void launch(const vec2f& dir, int owner);
+    void explode();
+
     vec2f m_dir;
     int   m_state;
-    float m_frame;
     float m_speed;
     float m_height;
-    float m_ttl;
 
-    std::vector<Sprite> m_sprites;
+    const Sprite* m_sprites; // shared, by state
 };
 #endif
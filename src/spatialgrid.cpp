@@ -0,0 +1,69 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include "spatialgrid.h"
+
+SpatialGrid::SpatialGrid(float cell_size) :
+    m_cell_size(cell_size),
+    m_count(0)
+{
+}
+
+/**
+ * Remove all objects. Cells are kept for reuse unless there are
+ * many more of them than objects, e.g. after objects spread out.
+ */
+void SpatialGrid::clear() {
+    if (m_cells.size() > 4 * m_count + 64) {
+        m_cells.clear();
+    }
+    else {
+        for (auto& cell : m_cells) {
+            cell.second.clear();
+        }
+    }
+    m_count = 0;
+}
+
+void SpatialGrid::insert(Object* object, const vec2f& pos) {
+    m_cells[getCell(pos)].push_back(object);
+    m_count++;
+}
+
+void SpatialGrid::remove(Object* object, const vec2f& pos) {
+    auto it = m_cells.find(getCell(pos));
+    if (it != m_cells.end()) {
+        auto& cell = it->second;
+        auto found = std::find(cell.begin(), cell.end(), object);
+
+        if (found != cell.end()) {
+            *found = cell.back();
+            cell.pop_back();
+            m_count--;
+        }
+    }
+}
+
+/**
+ * Update object position, nothing to do while it stays in its cell
+ */
+void SpatialGrid::move(Object* object, const vec2f& from, const vec2f& to) {
+    if (getCell(from) != getCell(to)) {
+        remove(object, from);
+        insert(object, to);
+    }
+}
@@ -0,0 +1,113 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <cmath>
+#include <vector>
+#include <unordered_map>
+#include "vec.h"
+
+class Object;
+
+/**
+ * Uniform grid of objects bucketed by position. The grid never looks
+ * into objects, callers keep it in sync by reporting every move.
+ * Cells stay allocated while empty so a steady scene does not allocate.
+ */
+class SpatialGrid {
+public:
+    explicit SpatialGrid(float cell_size = 1.0f);
+
+    void clear();
+    void insert(Object* object, const vec2f& pos);
+    void remove(Object* object, const vec2f& pos);
+    void move(Object* object, const vec2f& from, const vec2f& to);
+
+    inline vec2i getCell(const vec2f& pos) const {
+        return vec2i((int)std::floor(pos.x / m_cell_size), (int)std::floor(pos.y / m_cell_size));
+    }
+
+    inline float getCellSize() const {
+        return m_cell_size;
+    }
+
+    // visit objects of all cells overlapping the box
+    template <typename F>
+    void forEachInBox(const vec2f& lo, const vec2f& hi, F callback) const {
+        vec2i clo = getCell(lo), chi = getCell(hi);
+
+        // large boxes are cheaper to check cell by cell
+        if (double(chi.x - clo.x + 1) * double(chi.y - clo.y + 1) > m_cells.size()) {
+            for (auto& cell : m_cells) {
+                if (cell.first.x >= clo.x && cell.first.y >= clo.y && cell.first.x <= chi.x && cell.first.y <= chi.y) {
+                    for (Object* object : cell.second) {
+                        callback(object);
+                    }
+                }
+            }
+            return;
+        }
+
+        for (int x = clo.x; x <= chi.x; ++x) {
+            for (int y = clo.y; y <= chi.y; ++y) {
+                forEachInCell(vec2i(x, y), callback);
+            }
+        }
+    }
+
+    // visit objects of all cells overlapping the square of the radius around the position
+    template <typename F>
+    void forEachNear(const vec2f& pos, float radius, F callback) const {
+        forEachInBox(pos - vec2f(radius, radius), pos + vec2f(radius, radius), callback);
+    }
+
+    // visit objects of cells exactly `ring` cells away from the center cell (Chebyshev distance)
+    template <typename F>
+    void forEachInRing(const vec2i& center, int ring, F callback) const {
+        if (ring == 0) {
+            forEachInCell(center, callback);
+            return;
+        }
+        for (int i = -ring; i < ring; ++i) {
+            forEachInCell(center + vec2i(i, -ring), callback);
+            forEachInCell(center + vec2i(ring, i), callback);
+            forEachInCell(center + vec2i(-i, ring), callback);
+            forEachInCell(center + vec2i(-ring, -i), callback);
+        }
+    }
+
+    template <typename F>
+    void forEachInCell(const vec2i& cell, F callback) const {
+        auto it = m_cells.find(cell);
+        if (it != m_cells.end()) {
+            for (Object* object : it->second) {
+                callback(object);
+            }
+        }
+    }
+
+    inline size_t size() const {
+        return m_count;
+    }
+private:
+    float  m_cell_size;
+    size_t m_count;
+    std::unordered_map<vec2i, std::vector<Object*>> m_cells;
+};
+
+#endif
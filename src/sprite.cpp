@@ -16,12 +16,13 @@
  */
 #include <stdexcept>
 #include <SDL.h>
-#include <SDL_ttf.h>
 #include "game.h"
 #include "sprite.h"
+#include "spritebatch.h"
 
 Sprite::Sprite() :
     m_texture(nullptr),
+    m_batch(nullptr),
     m_must_destroy(false),
     m_start(0),
     m_count(0)
@@ -37,6 +38,9 @@ Sprite::~Sprite() {
  */
 void Sprite::destroy() {
     if (m_must_destroy && m_texture) {
+        if (m_batch) {
+            m_batch->release(m_texture);
+        }
         SDL_DestroyTexture(m_texture);
     }
     m_texture = nullptr;
@@ -45,7 +49,7 @@ void Sprite::destroy() {
 /**
  * Render sprite frame at specified position
  */
-void Sprite::render(SDL_Renderer* renderer, const vec2i& pos, int side, int frame, const vec2f& scale) {
+void Sprite::render(SDL_Renderer* renderer, const vec2i& pos, int side, int frame, const vec2f& scale) const {
     if (m_texture != nullptr) {
         SDL_Rect dst = {
             x: int(pos.x - m_offset.x * scale.x),
@@ -54,13 +58,16 @@ void Sprite::render(SDL_Renderer* renderer, const vec2i& pos, int side, int fram
             h: int(m_size.y * scale.y)
         };
         SDL_Rect src = {
-            x: m_size.x * (m_start + frame),
-            y: m_size.y * side,
+            x: m_origin.x + m_size.x * (m_start + frame),
+            y: m_origin.y + m_size.y * side,
             w: m_size.x,
             h: m_size.y
         };
 
-        if (SDL_RenderCopy(renderer, m_texture, &src, &dst) < 0) {
+        if (m_batch) {
+            m_batch->draw(m_texture, src, dst);
+        }
+        else if (SDL_RenderCopy(renderer, m_texture, &src, &dst) < 0) {
             throw std::runtime_error(SDL_GetError());
         }
     }
@@ -70,59 +77,29 @@ void Sprite::render(SDL_Renderer* renderer, const vec2i& pos, int side, int fram
  * Get cached texture from resource manager
  */
 void Sprite::load(Game& game, const std::string& filename, const vec2i& size, const vec2i& offset, int start, int count) {
-    int w, h;
+    vec2i sheet;
 
     destroy();
-
-    m_texture = game.getTexture(filename);
     m_must_destroy = false;
 
-    if (SDL_SetTextureBlendMode(m_texture, SDL_BLENDMODE_BLEND) < 0) {
-        throw std::runtime_error(SDL_GetError());
-    }
-    if (SDL_QueryTexture(m_texture, nullptr, nullptr, &w, &h) < 0) {
-        throw std::runtime_error(SDL_GetError());
+    // without a renderer only the frame layout is needed, for animations
+    if (!game.isHeadless()) {
+        m_texture = game.getSheet(filename, m_origin, sheet);
+        m_batch = &game.getBatch();
+
+        if (SDL_SetTextureBlendMode(m_texture, SDL_BLENDMODE_BLEND) < 0) {
+            throw std::runtime_error(SDL_GetError());
+        }
     }
 
     m_size   = size;
     m_offset = offset;
-    m_cols   = w / m_size.x;
-    m_rows   = h / m_size.y;
+    m_cols   = sheet.x / m_size.x;
+    m_rows   = sheet.y / m_size.y;
     m_start  = start;
     m_count  = count;
 }
 
-/**
- * Create a new texture and render some text on it
- */
-void Sprite::text(Game& game, const std::string& text, const std::string& fontname, int ptsize, int rgba) {
-    TTF_Font* font = game.getFont(fontname, ptsize);
-    SDL_Surface* surface;
-    SDL_Color color = {Uint8(rgba >> 24 & 0xff), Uint8((rgba >> 16) & 0xff), Uint8((rgba >> 8) & 0xff)};
-
-    destroy();
-
-    if ((surface = TTF_RenderText_Blended(font, text.c_str(), color)) == nullptr) {
-        throw std::runtime_error(TTF_GetError());
-    }
-    else {
-        if ((m_texture = SDL_CreateTextureFromSurface(game.getRenderer(), surface)) == nullptr) {
-            SDL_FreeSurface(surface);
-            throw std::runtime_error(SDL_GetError());
-        }
-        else {
-            m_size = vec2i(surface->w, surface->h);
-            m_offset = m_size / 2;
-            m_cols = 1;
-            m_rows = 1;
-            m_start = 0;
-            m_count = 1;
-            m_must_destroy = true;
-        }
-        SDL_FreeSurface(surface);
-    }
-}
-
 void Sprite::grad(Game& game, const vec2i& size, int rgba0, int rgba1) {
     SDL_Surface* surface;
 
@@ -153,6 +130,8 @@ void Sprite::grad(Game& game, const vec2i& size, int rgba0, int rgba1) {
             throw std::runtime_error(SDL_GetError());
         }
         else {
+            m_origin = vec2i();
+            m_batch = &game.getBatch();
             m_size = vec2i(surface->w, surface->h);
             m_offset = m_size / 2;
             m_cols = 1;
@@ -21,6 +21,7 @@
 #include "vec.h"
 
 class  Game;
+class  SpriteBatch;
 struct SDL_Texture;
 struct SDL_Renderer;
 
@@ -31,7 +32,6 @@ public:
 
     void destroy();
 
-    void text(Game&, const std::string& text,     const std::string& fontname, int ptsize, int rgba);
     void load(Game&, const std::string& filename, const vec2i& size, const vec2i& offset = vec2i(), int start = 0, int count = 1);
     void grad(Game&, const vec2i& size, int rgba0, int rgba1);
 
@@ -55,14 +55,16 @@ public:
         return m_rows;
     }
 
-    void render(SDL_Renderer*, const vec2i& pos, int side = 0, int frame = 0, const vec2f& scale = vec2f(1.0, 1.0));
+    void render(SDL_Renderer*, const vec2i& pos, int side = 0, int frame = 0, const vec2f& scale = vec2f(1.0, 1.0)) const;
 private:
     SDL_Texture* m_texture;
+    SpriteBatch* m_batch;
     bool m_must_destroy;
     int m_rows;
     int m_cols;
     int m_start;
     int m_count;
+    vec2i m_origin; // sheet position on its texture (atlas page)
     vec2i m_size;
     vec2i m_offset;
 };
@@ -0,0 +1,116 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+#include "spritebatch.h"
+
+const SDL_Color SpriteBatch::WHITE = {0xff, 0xff, 0xff, 0xff};
+
+SpriteBatch::SpriteBatch(SDL_Renderer* renderer) :
+    m_renderer(renderer),
+    m_texture(nullptr),
+    m_draw_calls(0),
+    m_frame_draw_calls(0)
+{
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    m_vertices.reserve(MAX_QUADS * 4);
+
+    // every quad is two triangles of its four corners, the pattern never changes
+    m_indices.reserve(MAX_QUADS * 6);
+    for (int i = 0; i < MAX_QUADS * 4; i += 4) {
+        m_indices.insert(m_indices.end(), {i, i + 1, i + 2, i + 2, i + 1, i + 3});
+    }
+#endif
+}
+
+/**
+ * Queue a textured rectangle tinted by the color, flush first if the texture changes
+ */
+void SpriteBatch::draw(SDL_Texture* texture, const SDL_Rect& src, const SDL_Rect& dst, const SDL_Color& color) {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    if (texture != m_texture || m_vertices.size() == MAX_QUADS * 4) {
+        flush();
+    }
+    if (texture != m_texture) {
+        int w, h;
+
+        if (SDL_QueryTexture(texture, nullptr, nullptr, &w, &h) < 0) {
+            throw std::runtime_error(SDL_GetError());
+        }
+        m_texture = texture;
+        m_texel = vec2f(1.0f / w, 1.0f / h);
+    }
+
+    float x0 = dst.x, y0 = dst.y, x1 = dst.x + dst.w, y1 = dst.y + dst.h;
+    float u0 = src.x * m_texel.x, v0 = src.y * m_texel.y;
+    float u1 = (src.x + src.w) * m_texel.x, v1 = (src.y + src.h) * m_texel.y;
+
+    m_vertices.push_back({{x0, y0}, color, {u0, v0}});
+    m_vertices.push_back({{x1, y0}, color, {u1, v0}});
+    m_vertices.push_back({{x0, y1}, color, {u0, v1}});
+    m_vertices.push_back({{x1, y1}, color, {u1, v1}});
+#else
+    bool tinted = color.r != 0xff || color.g != 0xff || color.b != 0xff || color.a != 0xff;
+
+    if (tinted && (SDL_SetTextureColorMod(texture, color.r, color.g, color.b) < 0 || SDL_SetTextureAlphaMod(texture, color.a) < 0)) {
+        throw std::runtime_error(SDL_GetError());
+    }
+    if (SDL_RenderCopy(m_renderer, texture, &src, &dst) < 0) {
+        throw std::runtime_error(SDL_GetError());
+    }
+    if (tinted) {
+        SDL_SetTextureColorMod(texture, 0xff, 0xff, 0xff);
+        SDL_SetTextureAlphaMod(texture, 0xff);
+    }
+    m_draw_calls++;
+#endif
+}
+
+/**
+ * Draw queued quads
+ */
+void SpriteBatch::flush() {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    if (!m_vertices.empty()) {
+        int count = (int)m_vertices.size();
+
+        if (SDL_RenderGeometry(m_renderer, m_texture, m_vertices.data(), count, m_indices.data(), count / 4 * 6) < 0) {
+            throw std::runtime_error(SDL_GetError());
+        }
+        m_vertices.clear();
+        m_draw_calls++;
+    }
+#endif
+}
+
+/**
+ * Forget a texture which is about to be destroyed
+ */
+void SpriteBatch::release(SDL_Texture* texture) {
+    if (texture == m_texture) {
+        flush();
+        m_texture = nullptr;
+    }
+}
+
+/**
+ * Finish the frame before it is presented
+ */
+void SpriteBatch::endFrame() {
+    flush();
+    m_frame_draw_calls = m_draw_calls;
+    m_draw_calls = 0;
+}
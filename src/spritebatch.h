@@ -0,0 +1,57 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SPRITEBATCH_H
+#define SPRITEBATCH_H
+
+#include <vector>
+#include <SDL.h>
+#include "vec.h"
+
+/**
+ * Collects textured quads and draws each run of one texture with a single
+ * SDL_RenderGeometry call. Anything drawn around it must flush it first.
+ * Before SDL 2.0.18 quads are copied one by one.
+ */
+class SpriteBatch {
+public:
+    enum { MAX_QUADS = 4096 };
+    static const SDL_Color WHITE;
+
+    explicit SpriteBatch(SDL_Renderer* renderer);
+
+    void draw(SDL_Texture* texture, const SDL_Rect& src, const SDL_Rect& dst, const SDL_Color& color = WHITE);
+    void flush();
+    void release(SDL_Texture* texture);
+    void endFrame();
+
+    // draw calls issued during the last frame
+    inline unsigned getDrawCalls() const {
+        return m_frame_draw_calls;
+    }
+private:
+    SDL_Renderer* m_renderer;
+    SDL_Texture*  m_texture;
+    vec2f         m_texel; // size of one texel in texture coordinates
+    unsigned      m_draw_calls;
+    unsigned      m_frame_draw_calls;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    std::vector<SDL_Vertex> m_vertices;
+    std::vector<int>        m_indices;
+#endif
+};
+
+#endif
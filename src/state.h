@@ -26,7 +26,8 @@ class State {
 public:
     State(Game& game): m_game(game) {}
     virtual ~State() {}
-    virtual void render(SDL_Renderer* renderer) = 0;
+    // alpha - how far the next update is, from 0 to 1, to draw in between the last two
+    virtual void render(SDL_Renderer* renderer, float alpha) = 0;
     virtual void onEvent(SDL_Event& ev) = 0;
     virtual void update(float dt) = 0;
 
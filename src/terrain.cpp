@@ -0,0 +1,282 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include "terrain.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define TERRAIN_SSE2
+#endif
+
+/*
+ * Vertex hashing kernels. Each one hashes `count` vertices starting at `pos`
+ * along y and flags hash % 6 != 0 (solid) and hash % 40 == 0 (seeded).
+ *
+ * std::hash<vec2i>(pos, seed) is hash_combine(hash_combine(seed, x), y), so
+ * along a row everything but the last step is constant:
+ *     hash = row ^ (y + 0x9e3779b9 + (row << 6) + (row >> 2))
+ * The SSE2 kernel relies on std::hash<int> being identity (libstdc++, libc++),
+ * hashRowScalar is used otherwise.
+ */
+using HashRowFn = void (*)(const vec2i& pos, size_t seed, int count, bool* solid, bool* seeded);
+
+static void hashRowScalar(const vec2i& pos, size_t seed, int count, bool* solid, bool* seeded) {
+    std::hash<vec2i> hasher;
+
+    for (int i = 0; i < count; ++i) {
+        size_t hash = hasher(pos + vec2i(0, i), seed);
+        solid[i] = hash % 6 != 0;
+        seeded[i] = hash % 40 == 0;
+    }
+}
+
+#ifdef TERRAIN_SSE2
+/*
+ * Modulo 6 and 40 without division: 256 = 1 (mod 3) and 256 = 1 (mod 5), so
+ * the byte sum of the hash (psadbw) has the same remainders mod 3 and 5,
+ * which are then taken with 16 bit reciprocal multiplication. Per element
+ * results are collected with movemask and spread to bool bytes with a table.
+ */
+static const uint32_t spread[16] = {
+    0x00000000, 0x00000001, 0x00000100, 0x00000101, 0x00010000, 0x00010001, 0x00010100, 0x00010101,
+    0x01000000, 0x01000001, 0x01000100, 0x01000101, 0x01010000, 0x01010001, 0x01010100, 0x01010101
+};
+
+static void hashRowSSE2(const vec2i& pos, size_t seed, int count, bool* solid, bool* seeded) {
+    std::hash<vec2i> hasher;
+    size_t row = seed;
+    hasher.hash_combine(row, std::hash<int>()(pos.x));
+
+    const __m128i zero   = _mm_setzero_si128();
+    const __m128i bit1   = _mm_set1_epi16(1);
+    const __m128i bit3   = _mm_set1_epi64x(7);
+    const __m128i inv3   = _mm_set1_epi16((short)0xAAAB);
+    const __m128i inv5   = _mm_set1_epi16((short)0xCCCD);
+    const __m128i three  = _mm_set1_epi16(3);
+    const __m128i five   = _mm_set1_epi16(5);
+    const __m128i step   = _mm_set1_epi64x(4);
+    const __m128i lrow   = _mm_set1_epi64x((long long)row);
+    const __m128i offset = _mm_set1_epi64x((long long)(0x9e3779b9 + (row << 6) + (row >> 2)));
+
+    __m128i y0 = _mm_set_epi64x(pos.y + 1, pos.y);
+    __m128i y1 = _mm_set_epi64x(pos.y + 3, pos.y + 2);
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        // two vectors share one set of 16 bit ops: words 0 and 4 hold y, y + 1, words 1 and 5 hold y + 2, y + 3
+        __m128i hash0 = _mm_xor_si128(lrow, _mm_add_epi64(y0, offset));
+        __m128i hash1 = _mm_xor_si128(lrow, _mm_add_epi64(y1, offset));
+        __m128i sum   = _mm_or_si128(_mm_sad_epu8(hash0, zero), _mm_slli_epi64(_mm_sad_epu8(hash1, zero), 16));
+        __m128i low   = _mm_or_si128(_mm_and_si128(hash0, bit3), _mm_slli_epi64(_mm_and_si128(hash1, bit3), 16));
+        __m128i mod3  = _mm_sub_epi16(sum, _mm_mullo_epi16(_mm_srli_epi16(_mm_mulhi_epu16(sum, inv3), 1), three));
+        __m128i mod5  = _mm_sub_epi16(sum, _mm_mullo_epi16(_mm_srli_epi16(_mm_mulhi_epu16(sum, inv5), 2), five));
+
+        unsigned div6  = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_or_si128(_mm_and_si128(low, bit1), mod3), zero));
+        unsigned div40 = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_or_si128(low, mod5), zero));
+
+        // byte mask bits 0, 8, 2, 10 -> y, y + 1, y + 2, y + 3
+        div6  = (div6 & 5) | ((div6 >> 7) & 10);
+        div40 = (div40 & 5) | ((div40 >> 7) & 10);
+
+        uint32_t solid4 = spread[~div6 & 0xf], seeded4 = spread[div40];
+        std::memcpy(solid + i, &solid4, 4);
+        std::memcpy(seeded + i, &seeded4, 4);
+
+        y0 = _mm_add_epi64(y0, step);
+        y1 = _mm_add_epi64(y1, step);
+    }
+    hashRowScalar(pos + vec2i(0, i), seed, count - i, solid + i, seeded + i);
+}
+#endif
+
+/**
+ * Pick the SSE2 kernel where the CPU and standard library allow it
+ */
+static Terrain::Kernel getBestKernel() {
+    // the SSE2 kernel reproduces std::hash only if it is identity on 64 bit size_t
+    std::hash<int> hasher;
+    if (sizeof(size_t) != 8 || hasher(-1) != size_t(-1) || hasher(123456789) != 123456789) {
+        return Terrain::KERNEL_SCALAR;
+    }
+#ifdef TERRAIN_SSE2
+    return Terrain::KERNEL_SSE2;
+#else
+    return Terrain::KERNEL_SCALAR;
+#endif
+}
+
+static Terrain::Kernel kernel = getBestKernel();
+
+static HashRowFn getHashRow(Terrain::Kernel kernel) {
+    switch (kernel) {
+#ifdef TERRAIN_SSE2
+        case Terrain::KERNEL_SSE2:
+            return hashRowSSE2;
+#endif
+        default:
+            return hashRowScalar;
+    }
+}
+
+/**
+ * Force a hashing kernel (e.g. for benchmarks). Fails if not supported.
+ */
+bool Terrain::setKernel(Kernel value) {
+    if (value > getBestKernel()) {
+        return false;
+    }
+    kernel = value;
+    return true;
+}
+
+Terrain::Kernel Terrain::getKernel() {
+    return kernel;
+}
+
+Terrain::Terrain(int seed) :
+    m_seed(seed)
+{
+}
+
+/**
+ * Get vertex height. Each vertex is shared by eight tiles.
+ */
+int Terrain::getVertexZ(const vec2i& pos) const {
+    // flat central area
+    if (pos.x >= -8 && pos.y >= -8 && pos.x <= 8 && pos.y <= 8) {
+        return 0;
+    }
+
+    // smooth 3x3
+    static const vec2i steps[] = {{0, 0}, {0, -1}, {-1, 0}, {+1, 0}, {0, +1}, {-1, -1}, {+1, -1}, {-1, +1}, {+1, +1}};
+    int result = 1;
+    for (auto step : steps) {
+        result = result && std::hash<vec2i>()(pos + step, m_seed) % 6;
+    }
+    return result;
+}
+
+/**
+ * get correct wall tile index
+ */
+int Terrain::getWallSpriteId(const vec2i& pos) const {
+    return
+        getVertexZ(pos + vec2i(1, 0))
+      | getVertexZ(pos + vec2i(0, 0)) << 1
+      | getVertexZ(pos + vec2i(1, 1)) << 2
+      | getVertexZ(pos + vec2i(0, 1)) << 3;
+}
+
+/**
+ * Procedural map generation
+ */
+bool Terrain::generate(Tile& tile, const vec2i& pos) const {
+    int a = getWallSpriteId(pos);
+
+    // if not a getWallSpriteId place some obstacles
+    if (a == 0) {
+        a = std::hash<vec2i>()(pos, m_seed) % 40;
+
+        // add a tree if there is enough space
+        if (a < 1 && getWallSpriteId(pos + vec2i(-1, 1)) == 0 && getWallSpriteId(pos + vec2i(1, -1)) == 0) {
+            a = 16 + a;
+        }
+        else {
+            a = -1;
+        }
+    }
+
+    tile.m_layers[0] = 0;
+    tile.m_layers[1] = -1;
+    tile.m_layers[2] = a;
+    return a == -1;
+}
+
+/**
+ * Generate all tiles of a chunk at once. Same result as generating each
+ * tile separately, but every vertex hash is computed only once.
+ */
+void Terrain::generate(Chunk& chunk, const vec2i& chunk_pos) const {
+    // Tree placement looks at wall ids of diagonal neighbours, wall ids look
+    // at the four tile corners, and corner heights smooth over 3x3 hashes.
+    // So the chunk needs hashes with a border of 2 and heights with a border of 1.
+    enum { HASHES = Chunk::SIZE + 5, VERTICES = Chunk::SIZE + 3, WALLS = Chunk::SIZE + 2 };
+
+    // byte sized flags combined with bitwise ops, so the compiler vectorizes the rows
+    bool    solid[HASHES][HASHES];      // hash % 6 != 0, at [-2, SIZE + 2]
+    bool    seeded[HASHES][HASHES];     // hash % 40 == 0
+    uint8_t across[VERTICES][HASHES];   // solid along 3 rows
+    uint8_t height[VERTICES][VERTICES]; // vertex z, at [-1, SIZE + 1]
+    uint8_t walls[WALLS][WALLS];        // wall sprite id, at [-1, SIZE]
+
+    HashRowFn hashRow = getHashRow(kernel);
+
+    for (int x = 0; x < HASHES; ++x) {
+        hashRow(chunk_pos + vec2i(x - 2, -2), m_seed, HASHES, solid[x], seeded[x]);
+    }
+
+    // smooth 3x3 (hash index = vertex index + 1)
+    for (int x = 0; x < VERTICES; ++x) {
+        for (int y = 0; y < HASHES; ++y) {
+            across[x][y] = solid[x][y] & solid[x + 1][y] & solid[x + 2][y];
+        }
+    }
+    for (int x = 0; x < VERTICES; ++x) {
+        for (int y = 0; y < VERTICES; ++y) {
+            height[x][y] = across[x][y] & across[x][y + 1] & across[x][y + 2];
+        }
+    }
+
+    // flat central area
+    for (int x = std::max(-8, chunk_pos.x - 1); x <= std::min(8, chunk_pos.x + Chunk::SIZE + 1); ++x) {
+        for (int y = std::max(-8, chunk_pos.y - 1); y <= std::min(8, chunk_pos.y + Chunk::SIZE + 1); ++y) {
+            height[x - chunk_pos.x + 1][y - chunk_pos.y + 1] = 0;
+        }
+    }
+
+    for (int x = 0; x < WALLS; ++x) {
+        for (int y = 0; y < WALLS; ++y) {
+            walls[x][y] =
+                height[x + 1][y    ]
+              | height[x    ][y    ] << 1
+              | height[x + 1][y + 1] << 2
+              | height[x    ][y + 1] << 3;
+        }
+    }
+
+    for (int x = 0; x < Chunk::SIZE; ++x) {
+        uint64_t passable = 0;
+
+        for (int y = 0; y < Chunk::SIZE; ++y) {
+            Tile& tile = chunk.m_tiles[x][y];
+            int a = walls[x + 1][y + 1];
+
+            // if not a wall place some obstacles, a tree if there is enough space
+            bool tree = seeded[x + 2][y + 2] & (walls[x][y + 2] == 0) & (walls[x + 2][y] == 0);
+            a = a ? a : (tree ? 16 : -1);
+
+            tile.m_layers[0] = 0;
+            tile.m_layers[1] = -1;
+            tile.m_layers[2] = a;
+            passable |= uint64_t(a == -1) << y;
+        }
+        chunk.m_passable[x] = passable;
+    }
+}
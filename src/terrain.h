@@ -0,0 +1,70 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <cstdint>
+#include "chunkgraph.h"
+#include "vec.h"
+
+struct Tile {
+    enum  { LAYERS = 3 };
+    int8_t m_layers[LAYERS]; // sprite ids, -1 - empty
+};
+
+struct Chunk {
+    enum { SIZE = 64, BUDGET = 256 };
+    Tile     m_tiles[SIZE][SIZE];
+    uint64_t m_passable[SIZE]; // bit y of m_passable[x] is set if tile [x][y] is passable
+    unsigned m_atime;          // frame of the last access
+    bool     m_dirty;          // not in the chunk store yet
+    ChunkGraph m_graph;        // built after the tiles, not stored
+
+    inline bool isPassable(const vec2i& local_pos) const {
+        return (m_passable[local_pos.x] >> local_pos.y) & 1;
+    }
+};
+
+/**
+ * Procedural map generator. Stateless apart from the seed, so it is safe
+ * to call from any thread.
+ */
+class Terrain {
+public:
+    enum Kernel { KERNEL_SCALAR, KERNEL_SSE2 };
+
+    explicit Terrain(int seed);
+
+    // vertex hashing kernel, the best supported one is used by default
+    static bool setKernel(Kernel);
+    static Kernel getKernel();
+
+    void generate(Chunk&, const vec2i& chunk_pos) const;
+
+    // per tile reference implementation, returns passability
+    bool generate(Tile&, const vec2i& pos) const;
+    int  getVertexZ(const vec2i& pos) const;
+    int  getWallSpriteId(const vec2i& pos) const;
+
+    inline int getSeed() const {
+        return m_seed;
+    }
+private:
+    int m_seed;
+};
+
+#endif
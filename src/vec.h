@@ -18,6 +18,7 @@
 #define VEC_H
 
 #include <cmath>
+#include <functional>
 
 template <typename T> struct vec2 {
     T x, y;
@@ -0,0 +1,168 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <stdexcept>
+#include <SDL.h>
+#include "worker.h"
+
+/**
+ * Start worker threads (by default one less than CPU count, at least one)
+ */
+WorkerPool::WorkerPool(int threads) :
+    m_lock(nullptr),
+    m_cond(nullptr),
+    m_done(nullptr),
+    m_quit(false),
+    m_batch(nullptr)
+{
+    if (threads <= 0) {
+        threads = std::max(1, SDL_GetCPUCount() - 1);
+    }
+
+    if ((m_lock = SDL_CreateMutex()) == nullptr || (m_cond = SDL_CreateCond()) == nullptr || (m_done = SDL_CreateCond()) == nullptr) {
+        throw std::runtime_error(SDL_GetError());
+    }
+
+    for (int i = 0; i < threads; ++i) {
+        SDL_Thread* thread = SDL_CreateThread(&WorkerPool::main, "worker", this);
+        if (thread == nullptr) {
+            throw std::runtime_error(SDL_GetError());
+        }
+        m_threads.push_back(thread);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    stop();
+
+    if (m_done) {
+        SDL_DestroyCond(m_done);
+    }
+    if (m_cond) {
+        SDL_DestroyCond(m_cond);
+    }
+    if (m_lock) {
+        SDL_DestroyMutex(m_lock);
+    }
+}
+
+/**
+ * Drop pending jobs and join threads
+ */
+void WorkerPool::stop() {
+    if (m_lock) {
+        SDL_LockMutex(m_lock);
+        m_quit = true;
+        m_jobs.clear();
+        SDL_CondBroadcast(m_cond);
+        SDL_UnlockMutex(m_lock);
+    }
+
+    for (auto thread : m_threads) {
+        SDL_WaitThread(thread, nullptr);
+    }
+    m_threads.clear();
+}
+
+/**
+ * Queue a job for execution on any worker
+ */
+void WorkerPool::push(Job job) {
+    SDL_LockMutex(m_lock);
+    m_jobs.push_back(std::move(job));
+    SDL_CondSignal(m_cond);
+    SDL_UnlockMutex(m_lock);
+}
+
+/**
+ * Run task(0) .. task(count - 1) on the calling thread and the workers.
+ * Returns when all of them are done. Tasks are claimed one by one, the
+ * caller keeps claiming too, so the batch completes even if stop() drops
+ * the queued jobs or the workers are busy. Called from one thread at a time.
+ */
+void WorkerPool::parallelFor(int count, const Task& task) {
+    Batch batch = {&task, count, 0, count};
+
+    SDL_LockMutex(m_lock);
+    m_batch = &batch;
+    SDL_UnlockMutex(m_lock);
+
+    // jobs refer to the pool, not the batch, late ones find no batch and return
+    for (int i = 1; i < count; ++i) {
+        push([this]() {
+            SDL_LockMutex(m_lock);
+            if (m_batch) {
+                runBatch(*m_batch);
+            }
+            SDL_UnlockMutex(m_lock);
+        });
+    }
+
+    SDL_LockMutex(m_lock);
+    runBatch(batch);
+    while (batch.m_pending > 0) {
+        SDL_CondWait(m_done, m_lock);
+    }
+    m_batch = nullptr;
+    SDL_UnlockMutex(m_lock);
+}
+
+/**
+ * Claim and run tasks of the batch until none is left, m_lock is held
+ * except while a task runs
+ */
+void WorkerPool::runBatch(Batch& batch) {
+    while (batch.m_next < batch.m_count) {
+        int index = batch.m_next++;
+
+        SDL_UnlockMutex(m_lock);
+        (*batch.m_task)(index);
+        SDL_LockMutex(m_lock);
+
+        if (--batch.m_pending == 0) {
+            SDL_CondSignal(m_done);
+        }
+    }
+}
+
+int WorkerPool::main(void* pool) {
+    static_cast<WorkerPool*>(pool)->run();
+    return 0;
+}
+
+/**
+ * Worker thread loop
+ */
+void WorkerPool::run() {
+    SDL_LockMutex(m_lock);
+
+    while (!m_quit) {
+        if (m_jobs.empty()) {
+            SDL_CondWait(m_cond, m_lock);
+            continue;
+        }
+
+        Job job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+
+        SDL_UnlockMutex(m_lock);
+        job();
+        SDL_LockMutex(m_lock);
+    }
+
+    SDL_UnlockMutex(m_lock);
+}
@@ -0,0 +1,70 @@
+/* Winter-Strike Game
+ * Copyright (C) 2019 Boris Kumok
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <deque>
+#include <vector>
+#include <functional>
+
+struct SDL_mutex;
+struct SDL_cond;
+struct SDL_Thread;
+
+/**
+ * Fixed set of background threads executing queued jobs in FIFO order.
+ * Jobs still queued on destruction are dropped, running ones are joined.
+ */
+class WorkerPool {
+public:
+    using Job = std::function<void()>;
+    using Task = std::function<void(int)>;
+
+    explicit WorkerPool(int threads = 0);
+    ~WorkerPool();
+
+    void push(Job job);
+    void stop();
+    void parallelFor(int count, const Task& task);
+
+    inline int size() const {
+        return (int)m_threads.size();
+    }
+private:
+    // tasks of a parallelFor(), claimed in order by whoever is free
+    struct Batch {
+        const Task* m_task;
+        int         m_count;
+        int         m_next;    // first unclaimed task
+        int         m_pending; // tasks not finished yet
+    };
+
+    static int main(void* pool);
+    void run();
+    void runBatch(Batch& batch);
+
+    SDL_mutex* m_lock;
+    SDL_cond*  m_cond;
+    SDL_cond*  m_done; // signalled when the last task of a parallelFor() ends
+    bool       m_quit;
+    Batch*     m_batch; // of the running parallelFor(), if any
+
+    std::deque<Job> m_jobs;
+    std::vector<SDL_Thread*> m_threads;
+};
+
+#endif
@@ -15,39 +15,46 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <algorithm>
-#include <queue>
+#include <limits>
+#include <stdexcept>
 #include <unordered_map>
+#include <unordered_set>
 #include <SDL.h>
 #include "game.h"
 #include "world.h"
 #include "object.h"
 #include "character.h"
+#include "spritebatch.h"
+
+thread_local World::UpdateSlice* World::current_slice = nullptr;
 
 World::World(Game& game, int seed) :
     State(game),
-    m_seed(seed)
+    m_terrain(seed),
+    m_player(nullptr),
+    m_frame(1),
+    m_random(seed),
+    m_deterministic(false),
+    m_sprites(game.getSprites(Game::SPRITE_TILES)),
+    m_index(16),
+    m_chunk_budget(Chunk::BUDGET),
+    m_chunk_stats(),
+    m_cached_layers(0),
+    m_tile_window_bits(0),
+    m_ready_lock(SDL_CreateMutex()),
+    m_ready_cond(SDL_CreateCond())
 {
-    SDL_RenderGetLogicalSize(m_game.getRenderer(), &m_viewport.x, &m_viewport.y);
+    if (m_ready_lock == nullptr || m_ready_cond == nullptr) {
+        throw std::runtime_error(SDL_GetError());
+    }
 
-    m_sprites.resize(17);
-    m_sprites[0 ].load(m_game, "tiles.png", vec2i(64, 128),  vec2i(32, 112), 0, 1);
-    m_sprites[1 ].load(m_game, "tiles.png", vec2i(64, 128),  vec2i(32, 112), 1, 1);
-    m_sprites[2 ].load(m_game, "tiles.png", vec2i(64, 128),  vec2i(32, 112), 2, 1);
-    m_sprites[3 ].load(m_game, "tiles.png", vec2i(64, 128),  vec2i(32, 112), 3, 1);
-    m_sprites[4 ].load(m_game, "tiles.png", vec2i(64, 128),  vec2i(32, 112), 4, 1);
-    m_sprites[5 ].load(m_game, "tiles.png", vec2i(64, 128),  vec2i(32, 112), 5, 1);
-    m_sprites[6 ].load(m_game, "tiles.png", vec2i(64, 128),  vec2i(32, 112), 6, 1);
-    m_sprites[7 ].load(m_game, "tiles.png", vec2i(64, 128),  vec2i(32, 112), 7, 1);
-    m_sprites[8 ].load(m_game, "tiles.png", vec2i(64, 128),  vec2i(32, 112), 8, 1);
-    m_sprites[9 ].load(m_game, "tiles.png", vec2i(64, 128),  vec2i(32, 112), 9, 1);
-    m_sprites[10].load(m_game, "tiles.png", vec2i(64, 128),  vec2i(32, 112), 10, 1);
-    m_sprites[11].load(m_game, "tiles.png", vec2i(64, 128),  vec2i(32, 112), 11, 1);
-    m_sprites[12].load(m_game, "tiles.png", vec2i(64, 128),  vec2i(32, 112), 12, 1);
-    m_sprites[13].load(m_game, "tiles.png", vec2i(64, 128),  vec2i(32, 112), 13, 1);
-    m_sprites[14].load(m_game, "tiles.png", vec2i(64, 128),  vec2i(32, 112), 14, 1);
-    m_sprites[15].load(m_game, "tiles.png", vec2i(64, 128),  vec2i(32, 112), 15, 1);
-    m_sprites[16].load(m_game, "trees.png", vec2i(128, 192), vec2i(64, 160), 0, 1);
+    SDL_RenderGetLogicalSize(m_game.getRenderer(), &m_viewport.x, &m_viewport.y);
 
+    // flat layers are drawn from pre-rendered blocks if the renderer supports render targets
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(m_game.getRenderer(), &info) == 0 && (info.flags & SDL_RENDERER_TARGETTEXTURE)) {
+        m_cached_layers = BLOCK_LAYERS;
+    }
 
     add(std::make_unique<Character>(*this, vec2f(0, 6), false));
     m_player = static_cast<Character*>(m_objects.back().get());
@@ -57,104 +64,329 @@ World::World(Game& game, int seed) :
     add(std::make_unique<Character>(*this, vec2f( 0,-7), true));
     add(std::make_unique<Character>(*this, vec2f( 1,-6), true));
     add(std::make_unique<Character>(*this, vec2f( 3,-5), true));
+
+    // chunks of this seed generated in previous sessions
+    std::string store = m_game.getChunkStoreFile(seed);
+    if (!store.empty()) {
+        m_store.open(store, seed);
+    }
+
+    // spawn area must be ready before the first frame
+    prefetchChunks(m_camera);
+    waitChunksAround(vec2i(0, 0));
+}
+
+World::~World() {
+    // workers may still publish chunks, stop them before the lock goes away
+    m_workers.stop();
+    dropBlocks();
+
+    const ObjectPoolBase::Stats& snowballs = m_snowballs.getStats();
+    const ObjectPoolBase::Stats& labels = m_labels.getStats();
+    SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Snowball pool: %zu allocated, peak %zu in use, %lu acquires", snowballs.m_size, snowballs.m_peak, snowballs.m_acquires);
+    SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Label pool: %zu allocated, peak %zu in use, %lu acquires", labels.m_size, labels.m_peak, labels.m_acquires);
+
+    Pathfinder::Stats paths = getPathStats();
+    SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Paths: %lu searches, %lu nodes expanded, %lu partial", paths.m_searches, paths.m_expanded, paths.m_partial);
+    RoutePlanner::Stats routes = getRouteStats();
+    SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Routes: %lu searches, %lu entrances expanded, %lu failed", routes.m_searches, routes.m_expanded, routes.m_failed);
+
+    if (m_store.isOpen()) {
+        collectChunks();
+        m_chunks.forEach([this](const vec2i& chunk_pos, Chunk& chunk) {
+            saveChunk(chunk_pos, chunk);
+        });
+    }
+    SDL_DestroyCond(m_ready_cond);
+    SDL_DestroyMutex(m_ready_lock);
+}
+
+/**
+ * Get origin of the chunk containing specified map coordinates
+ */
+vec2i World::getChunkPos(const vec2i& pos) {
+    // SIZE is a power of two, masking rounds negative coords down as well
+    return vec2i(pos.x & -Chunk::SIZE, pos.y & -Chunk::SIZE);
+}
+
+/**
+ * Get a resident chunk by its origin.
+ * Chunks which are not generated yet are requested and null is returned.
+ */
+Chunk* World::getChunk(const vec2i& chunk_pos) {
+    // object updates on workers only read the map, missing chunks are requested later.
+    // Chunks around objects are never evicted, they do not need access times.
+    if (current_slice) {
+        Chunk* chunk = m_chunks.find(chunk_pos, current_slice->m_chunk_cursor);
+        if (chunk) {
+            current_slice->m_chunk_hits++;
+        }
+        else {
+            std::vector<vec2i>& requests = current_slice->m_chunk_requests;
+            if (requests.empty() || requests.back() != chunk_pos) {
+                requests.push_back(chunk_pos);
+            }
+            current_slice->m_chunk_misses++;
+        }
+        return chunk;
+    }
+
+    Chunk* chunk = m_chunks.find(chunk_pos, m_chunk_cursor);
+    if (chunk == nullptr) {
+        m_chunk_stats.m_misses++;
+        requestChunk(chunk_pos);
+        return nullptr;
+    }
+    m_chunk_stats.m_hits++;
+
+    chunk->m_atime = m_frame;
+    return chunk;
 }
 
 /**
- * Get vertex height. Each vertex is shared by eight tiles.
+ * Get a visible tile from the ring buffer.
+ * Tiles scrolled into view are resolved once, until then they stay valid.
  */
-int World::getVertexZ(const vec2i& pos) {
-    // flat central area
-    if (pos.x >= -8 && pos.y >= -8 && pos.x <= 8 && pos.y <= 8) {
-        return 0;
+const World::TileRecord& World::getTileRecord(const vec2i& pos) {
+    int mask = (1 << m_tile_window_bits) - 1;
+    TileRecord& record = m_tile_window[((pos.y & mask) << m_tile_window_bits) | (pos.x & mask)];
+
+    if (!record.m_valid || record.m_pos != pos) {
+        vec2i chunk_pos = getChunkPos(pos);
+        const Chunk* chunk = getChunk(chunk_pos);
+
+        record.m_pos = pos;
+        record.m_offset = vec2i((pos.x - pos.y) * 32, (pos.x + pos.y) * 16);
+        // tiles of chunks which are not generated yet are resolved again next time
+        record.m_valid = chunk != nullptr;
+
+        for (int z = 0; z < Tile::LAYERS; ++z) {
+            record.m_sprites[z] = chunk ? chunk->m_tiles[pos.x - chunk_pos.x][pos.y - chunk_pos.y].m_layers[z] : -1;
+        }
     }
+    return record;
+}
 
-    // smooth 3x3
-    static const vec2i steps[] = {{0, 0}, {0, -1}, {-1, 0}, {+1, 0}, {0, +1}, {-1, -1}, {+1, -1}, {-1, +1}, {+1, +1}};
-    int result = 1;
-    for (auto step : steps) {
-        result = result && std::hash<vec2i>()(pos + step, m_seed) % 6;
+/**
+ * Queue loading of a stored chunk or its generation on a worker thread.
+ * Either way its graph for route searches is built there as well.
+ */
+void World::requestChunk(const vec2i& chunk_pos) {
+    if (m_requested.count(chunk_pos)) {
+        return; // already in flight
     }
-    return result;
+    m_requested.insert(chunk_pos);
+
+    m_workers.push([this, chunk_pos]() {
+        auto chunk = std::make_unique<Chunk>();
+
+        // chunks of the store are not dirty, generated ones are
+        chunk->m_dirty = !m_store.isOpen() || !m_store.load(chunk_pos, *chunk);
+        if (chunk->m_dirty) {
+            SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Create tiles: [%d,%d]:[%d,%d]", chunk_pos.x, chunk_pos.y, chunk_pos.x + Chunk::SIZE, chunk_pos.y + Chunk::SIZE);
+            m_terrain.generate(*chunk, chunk_pos);
+        }
+        chunk->m_graph.build(*chunk, chunk_pos, m_terrain);
+
+        SDL_LockMutex(m_ready_lock);
+        m_ready.emplace_back(chunk_pos, std::move(chunk));
+        SDL_CondBroadcast(m_ready_cond);
+        SDL_UnlockMutex(m_ready_lock);
+    });
 }
 
 /**
- * get correct wall tile index
+ * Block until chunk is ready or timeout (ms) expires
  */
-int World::getWallSpriteId(const vec2i& pos) {
-    return
-        getVertexZ(pos + vec2i(1, 0))
-      | getVertexZ(pos + vec2i(0, 0)) << 1
-      | getVertexZ(pos + vec2i(1, 1)) << 2
-      | getVertexZ(pos + vec2i(0, 1)) << 3;
+bool World::waitChunk(const vec2i& chunk_pos, unsigned timeout) {
+    Uint32 deadline = SDL_GetTicks() + timeout;
+
+    if (m_chunks.find(chunk_pos) == nullptr) {
+        requestChunk(chunk_pos);
+    }
+
+    for (collectChunks(); m_chunks.find(chunk_pos) == nullptr; collectChunks()) {
+        Uint32 now = SDL_GetTicks();
+        if (now >= deadline) {
+            return false;
+        }
+
+        SDL_LockMutex(m_ready_lock);
+        if (m_ready.empty()) {
+            SDL_CondWaitTimeout(m_ready_cond, m_ready_lock, deadline - now);
+        }
+        SDL_UnlockMutex(m_ready_lock);
+    }
+    return true;
 }
 
 /**
- * Procedural map generation
+ * Request chunks around specified position
  */
-void World::generate(Tile& tile, const vec2i& pos) {
-    int a = getWallSpriteId(pos);
+void World::prefetchChunks(const vec2f& pos) {
+    vec2i chunk_pos = getChunkPos(pos.round<int>());
+
+    for (int x = -1; x <= 1; ++x) {
+        for (int y = -1; y <= 1; ++y) {
+            vec2i neighbour = chunk_pos + vec2i(x, y) * Chunk::SIZE;
 
-    // if not a getWallSpriteId place some obstacles
-    if (a == 0) {
-        a = std::hash<vec2i>()(pos, m_seed) % 40;
+            if (m_chunks.find(neighbour) == nullptr) {
+                requestChunk(neighbour);
+            }
+        }
+    }
+}
 
-        // add a tree if there is enough space
-        if (a < 1 && getWallSpriteId(pos + vec2i(-1, 1)) == 0 && getWallSpriteId(pos + vec2i(1, -1)) == 0) {
-            a = 16 + a;
+/**
+ * Publish chunks finished by workers. Only the main thread touches m_chunks.
+ */
+void World::collectChunks() {
+    std::vector<std::pair<vec2i, std::unique_ptr<Chunk>>> ready;
+
+    SDL_LockMutex(m_ready_lock);
+    ready.swap(m_ready);
+    SDL_UnlockMutex(m_ready_lock);
+
+    for (auto& it : ready) {
+        // a request made again after a timeout may be answered twice
+        m_requested.erase(it.first);
+        if (m_chunks.find(it.first)) {
+            continue;
+        }
+        it.second->m_atime = m_frame;
+        if (it.second->m_dirty) {
+            m_chunk_stats.m_generations++;
         }
         else {
-            a = -1;
+            m_chunk_stats.m_loads++;
         }
+        m_chunks.insert(it.first, std::move(it.second));
     }
+}
 
-    tile.m_layers[0] = 0;
-    tile.m_layers[1] = -1;
-    tile.m_layers[2] = a;
-    tile.m_passable = (a == -1);
+/**
+ * Write back a generated chunk to the chunk store
+ */
+void World::saveChunk(const vec2i& chunk_pos, Chunk& chunk) {
+    if (chunk.m_dirty && m_store.save(chunk_pos, chunk)) {
+        chunk.m_dirty = false;
+        m_chunk_stats.m_saves++;
+    }
 }
 
 /**
- * Get or generate a tile at specified map coordinates
+ * Limit number of resident chunks (0 - unlimited)
  */
-World::Tile& World::getTile(const vec2i& pos) {
-    vec2i local_pos = (pos % Chunk::SIZE + vec2i(Chunk::SIZE, Chunk::SIZE)) % Chunk::SIZE;
-    vec2i chunk_pos = pos - local_pos;
+void World::setChunkBudget(size_t chunks) {
+    m_chunk_budget = chunks;
+}
+
+/**
+ * Limit memory used by resident chunks
+ */
+void World::setChunkMemoryBudget(size_t bytes) {
+    m_chunk_budget = std::max<size_t>(1, bytes / sizeof(Chunk));
+}
 
-    Chunk& chunk = m_chunks[chunk_pos];
+/**
+ * Drop least recently used chunks when over budget.
+ * Chunks around the camera and live objects are never evicted.
+ */
+void World::evictChunks() {
+    if (m_chunk_budget == 0 || m_chunks.size() <= m_chunk_budget) {
+        return;
+    }
 
-    if (chunk.m_atime == 0) {
-        SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Create tiles: [%d,%d]:[%d,%d]", chunk_pos.x, chunk_pos.y, chunk_pos.x + Chunk::SIZE, chunk_pos.y + Chunk::SIZE);
+    std::unordered_set<vec2i> pinned;
+    auto pin = [&pinned](const vec2f& pos) {
+        vec2i chunk_pos = getChunkPos(pos.round<int>());
 
-        for (int x = 0; x < Chunk::SIZE; ++x) {
-            for (int y = 0; y < Chunk::SIZE; ++y) {
-                generate(chunk.m_tiles[x][y], chunk_pos + vec2i(x, y));
+        for (int x = -1; x <= 1; ++x) {
+            for (int y = -1; y <= 1; ++y) {
+                pinned.insert(chunk_pos + vec2i(x, y) * Chunk::SIZE);
             }
         }
+    };
+
+    pin(m_camera);
+    pin(m_lookahead);
+    for (auto& object : m_objects) {
+        pin(object->getPosition());
     }
-    chunk.m_atime = SDL_GetTicks();
 
-    return chunk.m_tiles[local_pos.x][local_pos.y];
+    std::vector<std::pair<unsigned, vec2i>> lru;
+    m_chunks.forEach([&](const vec2i& chunk_pos, const Chunk& chunk) {
+        if (pinned.count(chunk_pos) == 0) {
+            lru.emplace_back(chunk.m_atime, chunk_pos);
+        }
+    });
+    std::sort(lru.begin(), lru.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    for (size_t i = 0; i < lru.size() && m_chunks.size() > m_chunk_budget; ++i) {
+        const vec2i& chunk_pos = lru[i].second;
+
+        SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Evict tiles: [%d,%d]:[%d,%d]", chunk_pos.x, chunk_pos.y, chunk_pos.x + Chunk::SIZE, chunk_pos.y + Chunk::SIZE);
+        saveChunk(chunk_pos, *m_chunks.find(chunk_pos));
+        dropBlocks(chunk_pos);
+        m_chunks.erase(chunk_pos);
+        m_chunk_stats.m_evictions++;
+    }
 }
 
 /**
- * Check if objects can move here
+ * Make chunks around objects resident, so what objects see of the map
+ * does not depend on how fast the workers generate it
  */
-bool World::isPassable(const vec2i& pos) {
-    return getTile(pos).m_passable;
+void World::waitObjectChunks() {
+    vec2i last(1, 1); // not a chunk origin
+
+    for (size_t i = 0; i < m_entities.size(); ++i) {
+        vec2i chunk_pos = getChunkPos(m_entities.getPositionAt(i).round<int>());
+        if (chunk_pos != last) {
+            waitChunksAround(chunk_pos);
+            last = chunk_pos;
+        }
+    }
 }
 
 /**
- * Find objects near position.
+ * Block until the chunk and its eight neighbours are resident.
+ * A request that timed out is made again, its job may have been dropped.
  */
-std::vector<Object*> World::getObjectsInRadius(const vec2f& pos, float radius) {
-    std::vector<Object*> result;
-
-    for (auto& object : m_objects) {
-        if ((pos - object->getPosition()).length() < radius) {
-            result.push_back(object.get());
+void World::waitChunksAround(const vec2i& chunk_pos) {
+    for (int x = -1; x <= 1; ++x) {
+        for (int y = -1; y <= 1; ++y) {
+            vec2i neighbour = chunk_pos + vec2i(x, y) * Chunk::SIZE;
+
+            for (int tries = 0; !waitChunk(neighbour, CHUNK_WAIT); ++tries) {
+                if (tries + 1 == CHUNK_WAIT_TRIES) {
+                    throw std::runtime_error("Tiles not ready: [" + std::to_string(neighbour.x) + "," + std::to_string(neighbour.y) + "]");
+                }
+                SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Waiting for tiles: [%d,%d]", neighbour.x, neighbour.y);
+                m_requested.erase(neighbour);
+            }
         }
     }
-    return result;
+}
+
+/**
+ * Check if objects can move here
+ */
+bool World::isPassable(const vec2i& pos) {
+    vec2i chunk_pos = getChunkPos(pos);
+    const Chunk* chunk = getChunk(chunk_pos);
+
+    // tiles of chunks which are not generated yet are not passable
+    return chunk && chunk->isPassable(pos - chunk_pos);
+}
+
+/**
+ * Move object keeping the spatial indices in sync
+ */
+void World::moveObject(Object& object, const vec2f& pos) {
+    m_grid.move(&object, object.getPosition(), pos);
+    m_index.move(&object, object.getPosition(), pos);
+    object.setPosition(pos);
 }
 
 /**
@@ -164,6 +396,8 @@ void World::renderMarker(SDL_Renderer* renderer, const vec2f& pos, unsigned rgba
     vec2i v = worldToScreen(pos);
     SDL_Point points[] = {{v.x, v.y + 16}, {v.x - 32, v.y}, {v.x, v.y - 16}, {v.x + 32, v.y}, {v.x, v.y + 16}};
 
+    m_game.getBatch().flush();
+
     SDL_SetRenderDrawColor(renderer, Uint8(rgba >> 24 & 0xff), Uint8((rgba >> 16) & 0xff), Uint8( (rgba >> 8) & 0xff), Uint8(rgba & 0xff));
     SDL_RenderDrawLines(renderer, points, sizeof(points) / sizeof(points[0]));
 }
@@ -172,7 +406,7 @@ void World::renderMarker(SDL_Renderer* renderer, const vec2f& pos, unsigned rgba
  * Convert world grid coordinates to screen pixel coordinates
  */
 const vec2i World::worldToScreen(const vec2f& pos) const {
-    vec2f v = (pos - m_camera) * 64;
+    vec2f v = (pos - m_view) * 64;
     return vec2i(std::round((v.x - v.y) / 2), std::round((v.x + v.y) / 4)) + m_viewport / 2;
 }
 
@@ -181,13 +415,152 @@ const vec2i World::worldToScreen(const vec2f& pos) const {
  */
 const vec2f World::screenToWorld(const vec2i& pos) const {
     vec2i v = pos - m_viewport / 2;
-    return vec2f(2.0 * v.y + v.x, 2.0 * v.y - v.x) / 64 + m_camera;
+    return vec2f(2.0 * v.y + v.x, 2.0 * v.y - v.x) / 64 + m_view;
+}
+
+/**
+ * Get pre-rendered flat layers of a tile block, render them on first use.
+ * Blocks of chunks which are not generated yet are not rendered.
+ */
+SDL_Texture* World::getBlock(SDL_Renderer* renderer, const vec2i& block_pos) {
+    auto it = m_blocks.find(block_pos);
+    if (it != m_blocks.end()) {
+        it->second.m_atime = m_frame;
+        return it->second.m_texture;
+    }
+
+    // a block never crosses chunk borders
+    vec2i chunk_pos = getChunkPos(block_pos);
+    const Chunk* chunk = getChunk(chunk_pos);
+    if (chunk == nullptr) {
+        return nullptr;
+    }
+
+    // make room for the new block, blocks drawn this frame stay
+    if (m_blocks.size() >= BLOCK_BUDGET) {
+        auto lru = std::min_element(m_blocks.begin(), m_blocks.end(), [](const auto& a, const auto& b) {
+            return a.second.m_atime < b.second.m_atime;
+        });
+        if (lru->second.m_atime != m_frame) {
+            m_game.getBatch().release(lru->second.m_texture);
+            SDL_DestroyTexture(lru->second.m_texture);
+            m_blocks.erase(lru);
+        }
+    }
+
+    const vec2i& size = m_sprites[0].getSize();
+    const vec2i origin((BLOCK_SIZE - 1) * size.x / 2 + m_sprites[0].getOffset().x, m_sprites[0].getOffset().y);
+
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+                                             BLOCK_SIZE * size.x, (BLOCK_SIZE - 1) * size.x / 2 + size.y);
+    if (texture == nullptr) {
+        throw std::runtime_error(SDL_GetError());
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+    // queued sprites belong to the current target
+    m_game.getBatch().flush();
+
+    SDL_Texture* target = SDL_GetRenderTarget(renderer);
+    if (SDL_SetRenderTarget(renderer, texture) < 0) {
+        SDL_DestroyTexture(texture);
+        throw std::runtime_error(SDL_GetError());
+    }
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+
+    vec2i local = block_pos - chunk_pos;
+    for (int z = 0; z < m_cached_layers; ++z) {
+        // back to front, same order as the per tile path
+        for (int a = 0; a < 2 * BLOCK_SIZE - 1; ++a) {
+            for (int x = std::max(0, a - BLOCK_SIZE + 1); x <= std::min(a, BLOCK_SIZE - 1); ++x) {
+                int y = a - x;
+                const Tile& tile = chunk->m_tiles[local.x + x][local.y + y];
+
+                if (tile.m_layers[z] >= 0) {
+                    m_sprites[tile.m_layers[z]].render(renderer, origin + vec2i((x - y) * size.x / 2, (x + y) * size.x / 4), 0, 0);
+                }
+            }
+        }
+    }
+    m_game.getBatch().flush();
+    SDL_SetRenderTarget(renderer, target);
+
+    SDL_LogDebug(SDL_LOG_CATEGORY_TEST, "Render block: [%d,%d]", block_pos.x, block_pos.y);
+    m_blocks[block_pos] = Block{texture, m_frame};
+    return texture;
+}
+
+/**
+ * Release pre-rendered blocks of a chunk
+ */
+void World::dropBlocks(const vec2i& chunk_pos) {
+    for (auto it = m_blocks.begin(); it != m_blocks.end(); ) {
+        if (getChunkPos(it->first) == chunk_pos) {
+            m_game.getBatch().release(it->second.m_texture);
+            SDL_DestroyTexture(it->second.m_texture);
+            it = m_blocks.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
 }
 
 /**
- * Main rendering function. Draw world and its objects.
+ * Release all pre-rendered blocks
  */
-void World::render(SDL_Renderer* renderer) {
+void World::dropBlocks() {
+    for (auto& it : m_blocks) {
+        m_game.getBatch().release(it.second.m_texture);
+        SDL_DestroyTexture(it.second.m_texture);
+    }
+    m_blocks.clear();
+}
+
+/**
+ * Draw flat tile layers from pre-rendered blocks
+ */
+void World::renderBlocks(SDL_Renderer* renderer) {
+    const vec2i& size = m_sprites[0].getSize();
+    const vec2i origin((BLOCK_SIZE - 1) * size.x / 2 + m_sprites[0].getOffset().x, m_sprites[0].getOffset().y);
+    const SDL_Rect view = {0, 0, m_viewport.x, m_viewport.y};
+
+    // map area under the screen, a block wider to catch tall tile sprites
+    vec2f corners[] = {screenToWorld(vec2i()), screenToWorld(vec2i(m_viewport.x, 0)),
+                       screenToWorld(vec2i(0, m_viewport.y)), screenToWorld(m_viewport)};
+    vec2f lo = corners[0], hi = corners[0];
+    for (auto& corner : corners) {
+        lo = vec2f(fmin(lo.x, corner.x), fmin(lo.y, corner.y));
+        hi = vec2f(fmax(hi.x, corner.x), fmax(hi.y, corner.y));
+    }
+    int x0 = int(floor(lo.x / BLOCK_SIZE)) - 1, y0 = int(floor(lo.y / BLOCK_SIZE)) - 1;
+    int x1 = int(floor(hi.x / BLOCK_SIZE)) + 1, y1 = int(floor(hi.y / BLOCK_SIZE)) + 1;
+
+    // back to front by diagonals
+    for (int s = x0 + y0; s <= x1 + y1; ++s) {
+        for (int bx = std::max(x0, s - y1); bx <= std::min(x1, s - y0); ++bx) {
+            vec2i block_pos = vec2i(bx, s - bx) * BLOCK_SIZE;
+            vec2i pos = worldToScreen(vec2f(block_pos)) - origin;
+            SDL_Rect dst = {pos.x, pos.y, BLOCK_SIZE * size.x, (BLOCK_SIZE - 1) * size.x / 2 + size.y};
+
+            if (!SDL_HasIntersection(&dst, &view)) {
+                continue;
+            }
+            if (SDL_Texture* texture = getBlock(renderer, block_pos)) {
+                m_game.getBatch().draw(texture, SDL_Rect{0, 0, dst.w, dst.h}, dst);
+            }
+        }
+    }
+}
+
+/**
+ * Main rendering function. Draw world and its objects,
+ * moving ones in between their last two positions.
+ */
+void World::render(SDL_Renderer* renderer, float alpha) {
+    m_view = m_entities.getInterpolated(m_player->getEntity(), alpha);
+
     vec2f lt = screenToWorld(vec2i() - m_sprites[16].getOffset()),
           rb = screenToWorld(m_viewport + m_sprites[16].getOffset());
 
@@ -199,48 +572,111 @@ void World::render(SDL_Renderer* renderer) {
     int cx = ceil((rb.x - rb.y - lt.x + lt.y + 1) / 2 + 1);
     int cy = ceil(rb.x + rb.y - lt.x - lt.y + 1);
 
-    for (int z = 0; z < Tile::LAYERS; ++z) {
+    // ring buffer must hold the whole visible diamond without aliasing
+    if ((1 << m_tile_window_bits) < cx + cy / 2 + 2) {
+        while ((1 << m_tile_window_bits) < cx + cy / 2 + 2) {
+            m_tile_window_bits++;
+        }
+        m_tile_window.assign(1 << (2 * m_tile_window_bits), TileRecord());
+    }
+    const vec2i origin = worldToScreen(vec2f());
+
+    // flat layers are drawn all at once, objects on them go on top
+    if (m_cached_layers > 0) {
+        renderBlocks(renderer);
+    }
+    m_render_queue.clear();
+
+    // tiles of the other layers
+    if (m_cached_layers < Tile::LAYERS) {
         vec2f pos = lt;
 
         for (int a = 0; a < cy; ++a) {
             for (int b = 0; b < cx; ++b) {
-                Tile& tile = getTile(vec2i(pos));
+                const TileRecord& tile = getTileRecord(vec2i(pos));
 
-                if (tile.m_layers[z] >= 0) {
-                    m_sprites[tile.m_layers[z]].render(renderer, worldToScreen(pos), 0, 0);
+                for (int z = m_cached_layers; z < Tile::LAYERS; ++z) {
+                    if (tile.m_sprites[z] >= 0) {
+                        m_render_queue.push(RenderQueue::getTileKey(z, vec2i(pos), tile.m_sprites[z]), &m_sprites[tile.m_sprites[z]], origin + tile.m_offset);
+                    }
                 }
-
                 pos += vec2f(1, -1);
             }
 
-            for (auto& it : m_objects) {
-                vec2f objpos = it->getPosition();
-
-                if (it->getZ() == z && (int)std::round(objpos.x + objpos.y) == (int)(pos.x + pos.y)) {
-                    it->render(renderer, worldToScreen(objpos));
-                }
-            }
-
             pos += vec2f(-cx, cx);
             pos += a % 2 ? vec2f(1, 0) : vec2f(0, 1);
         }
-
-        if (z == 1) {
-            renderMarker(renderer, screenToWorld(m_cursor).round<float>(), 0x80ff80ff);
-        }
     }
 
-    for (auto& it : m_objects) {
-        if (it->getZ() >= Tile::LAYERS) {
-            it->render(renderer, worldToScreen(it->getPosition()));
+    // objects in view, their sprites may stick out of the position by a margin
+    unsigned seq = 0;
+    for (auto& object : m_objects) {
+        vec2f world_pos = m_entities.getInterpolated(object->getEntity(), alpha);
+        vec2i pos = worldToScreen(world_pos);
+
+        if (pos.x < -CULL_MARGIN || pos.y < -CULL_MARGIN || pos.x > m_viewport.x + CULL_MARGIN || pos.y > m_viewport.y + CULL_MARGIN) {
+            continue;
         }
+        m_render_queue.push(RenderQueue::getObjectKey(object->getZ(), world_pos, seq++), object.get(), pos);
     }
+    m_render_queue.sort();
+
+    // cursor marker goes above the flat layers
+    m_render_queue.render(renderer, RenderQueue::getLayerKey(2));
+    renderMarker(renderer, screenToWorld(m_cursor).round<float>(), 0x80ff80ff);
+    m_render_queue.render(renderer);
 }
 
 /**
  * Add object to the world
  */
 void World::add(std::unique_ptr<Object> object) {
+    attach(ObjectPtr(object.release()));
+}
+
+void World::addSnowball(const vec2f& pos, const vec2f& dir, int owner_id) {
+    if (current_slice) {
+        Command& command = pushCommand(Command::SPAWN_SNOWBALL);
+        command.m_pos = pos;
+        command.m_dir = dir;
+        command.m_owner_id = owner_id;
+        return;
+    }
+    attach(ObjectPtr(m_snowballs.acquire(*this, pos, dir, owner_id)));
+}
+
+void World::addLabel(const vec2f& pos, const std::string& text, unsigned size, unsigned rgba, float ttl) {
+    if (current_slice) {
+        Command& command = pushCommand(Command::SPAWN_LABEL);
+        command.m_pos = pos;
+        command.m_text = text;
+        command.m_size = size;
+        command.m_value = rgba;
+        command.m_ttl = ttl;
+        return;
+    }
+    attach(ObjectPtr(m_labels.acquire(*this, pos, text, size, rgba, ttl)));
+}
+
+void World::setType(Object& object, unsigned type) {
+    if (current_slice) {
+        Command& command = pushCommand(Command::SET_TYPE);
+        command.m_object = &object;
+        command.m_value = type;
+        return;
+    }
+    m_entities.setType(object.getEntity(), type);
+}
+
+World::Command& World::pushCommand(Command::Kind kind) {
+    current_slice->m_commands.emplace_back();
+    current_slice->m_commands.back().m_kind = kind;
+    return current_slice->m_commands.back();
+}
+
+void World::attach(ObjectPtr object) {
+    m_grid.insert(object.get(), object->getPosition());
+    m_index.insert(object.get(), object->getPosition());
     m_objects.push_back(std::move(object));
 }
 
@@ -248,161 +684,301 @@ void World::add(std::unique_ptr<Object> object) {
  * Move and update objects
  */
 void World::update(float dt) {
-    // movement and collision detection
-    for (size_t i = 0; i < m_objects.size(); ++i) {
-        Object& object = *m_objects[i];
+    // recorded actions were taken before this update, checks compare the state after them
+    Replay::Record record;
+    while (isPlayingBack() && m_replay->next(m_frame, record)) {
+        if (record.m_action == Replay::CHECK) {
+            if (record.m_pos != getChecksum()) {
+                throw std::runtime_error("Replay out of sync at frame " + std::to_string(m_frame));
+            }
+            continue;
+        }
+        playerAction(record.m_action, record.m_pos);
+    }
+    if (m_replay && m_replay->isRecording() && m_frame % CHECK_INTERVAL == 0) {
+        m_replay->write({m_frame, uint8_t(Replay::CHECK), getChecksum()});
+    }
 
-        // backup position
-        vec2f backup_pos = object.getPosition();
+    collectChunks();
+    if (m_deterministic) {
+        waitObjectChunks();
+    }
 
-        // update and move object
-        object.update(dt);
+    // systems over the entity arrays
+    m_entities.saveMotion();
+    m_entities.updateMotion(dt);
+    m_entities.updateAges(dt);
+    m_entities.updateAnimations(dt);
+
+    // spatial indices, kept in sync with every move below
+    m_grid.clear();
+    m_index.clear();
+    for (size_t i = 0; i < m_entities.size(); ++i) {
+        m_grid.insert(m_entities.getObjectAt(i), m_entities.getPositionAt(i));
+        m_index.insert(m_entities.getObjectAt(i), m_entities.getPositionAt(i));
+    }
 
-        // check for collisions
-        if (object.isSolid() || object.isCollider()) {
-            vec2i ipos = object.getPosition().round<int>();
-            if (!isPassable(ipos)) {
-                // restore position
-                if (object.isSolid()) {
-                    object.setPosition(backup_pos);
-                }
-                // notify collision with world
-                if (object.isCollider()) {
-                    object.onCollision(nullptr);
-                }
+    updateObjects(dt);
+
+    // collision detection, moves are undone back to the position the frame started at.
+    // Whether an entity moved is taken first, undoing a move must not change it.
+    m_moved.resize(m_entities.size());
+    for (size_t i = 0; i < m_entities.size(); ++i) {
+        m_moved[i] = m_entities.getPositionAt(i) != m_entities.getPrevPositionAt(i);
+    }
+    auto isMoved = [this](const Object& object) {
+        size_t index = m_entities.getIndex(object.getEntity());
+        return index < m_moved.size() && m_moved[index];
+    };
+
+    for (size_t i = 0; i < m_entities.size(); ++i) {
+        if (!(m_entities.getFlagsAt(i) & (Object::FLAG_SOLID | Object::FLAG_COLLIDER))) {
+            continue;
+        }
+        Object& object = *m_entities.getObjectAt(i);
+        vec2f backup_pos = m_entities.getPrevPositionAt(i);
+
+        vec2i ipos = object.getPosition().round<int>();
+
+        if (!isPassable(ipos)) {
+            // restore position
+            if (object.isSolid()) {
+                moveObject(object, backup_pos);
+            }
+            // notify collision with world
+            if (object.isCollider()) {
+                object.onCollision(nullptr);
             }
+        }
 
-            for (size_t j = 0; j < m_objects.size(); ++j) {
-                if (i == j) {
-                    continue;
-                }
-                Object& other = *m_objects[j];
-                bool solid = object.isSolid() && other.isSolid();
-                bool collider = object.isCollider() && other.isCollider();
+        // pairs are handled once: by the object which moved,
+        // or by the older one if both did
+        if (!isMoved(object)) {
+            continue;
+        }
 
-                if (!solid && !collider) {
-                    continue;
-                }
+        // candidates around both positions the object may end up at, in creation order
+        m_contacts.clear();
+        m_grid.forEachNear(object.getPosition(), CONTACT_RADIUS + (object.getPosition() - backup_pos).length(), [&](Object* other) {
+            if (other != &object) {
+                m_contacts.push_back(other);
+            }
+        });
+        std::sort(m_contacts.begin(), m_contacts.end(), [](const Object* a, const Object* b) {
+            return a->getObjectId() < b->getObjectId();
+        });
+
+        for (Object* other : m_contacts) {
+            unsigned flags = object.getFlags() & other->getFlags();
+            bool solid = (flags & Object::FLAG_SOLID) != 0;
+            bool collider = (flags & Object::FLAG_COLLIDER) != 0;
+            bool other_moved = isMoved(*other);
+
+            if (flags == 0 || (other_moved && other->getObjectId() < object.getObjectId())) {
+                continue;
+            }
+            if ((object.getPosition() - other->getPosition()).squareLength() > 0.5) {
+                continue;
+            }
 
-                if ((object.getPosition() - other.getPosition()).squareLength() <= 0.5) {
-                    // restore position
-                    if (solid) {
-                        object.setPosition(backup_pos);
-                    }
-                    // notify collision
-                    if (collider) {
-                        object.onCollision(&other);
-                        other.onCollision(&object);
-                    }
+            // restore positions of both, a resting object stays where it is
+            if (solid) {
+                moveObject(object, backup_pos);
+                if (other_moved) {
+                    moveObject(*other, m_entities.getPrevPosition(other->getEntity()));
                 }
             }
+            // notify collision, once per frame on each side
+            if (collider) {
+                object.onCollision(other);
+                other->onCollision(&object);
+            }
         }
     }
 
+    // prefetch terrain around the camera and ahead of it
+    vec2f motion = m_player->getPosition() - m_camera;
     m_camera = m_player->getPosition();
 
-    // remove dead
-    m_objects.erase(std::remove_if(m_objects.begin(), m_objects.end(), [](const auto& o) { return !o->isAlive(); }), m_objects.end());
-
-    // do z-sorting (FIXME: move to render?)
-    std::sort(m_objects.begin(), m_objects.end(), [](const auto& a, const auto& b) {
-        vec2f posa = a->getPosition(), posb = b->getPosition();
-        int  za = a->getZ(), zb = b->getZ();
+    if (!motion.is0()) {
+        motion.normalize();
+        m_lookahead = m_camera + motion * Chunk::SIZE;
+    }
+    prefetchChunks(m_camera);
+    prefetchChunks(m_lookahead);
 
-        return (za < zb) || ((za == zb) && (posa.x + posa.y) < (posb.x + posb.y));
-    });
-}
+    // remove dead, queries between frames must not see them
+    m_objects.erase(std::remove_if(m_objects.begin(), m_objects.end(), [this](const auto& o) {
+        if (o->isAlive()) {
+            return false;
+        }
+        m_grid.remove(o.get(), o->getPosition());
+        m_index.remove(o.get(), o->getPosition());
+        return true;
+    }), m_objects.end());
 
-/**
- * 8-direction move cost heuristic
- */
-static inline int octile_heuristic(const vec2i& v) {
-    int dx = std::abs(v.x), dy = std::abs(v.y);
-    return (dx > dy) ? (1000 * dx + 414 * dy) : (1000 * dy + 414 * dx);
+    evictChunks();
+    m_frame++;
 }
 
 /**
- * A-star pathfinding
+ * Update objects which think or were woken up by the systems.
+ * Slices of them are updated in parallel. An update may read anything,
+ * but changes only its own object and entity, positions are left to the
+ * motion system. Other changes are queued per slice and applied in object
+ * order, so the outcome does not depend on the number of threads.
  */
-std::vector<vec2f> World::buildPath(const vec2f& fstart, const vec2f& fgoal) {
-    static const vec2i steps[] = {{0, -1}, {-1, 0}, {+1, 0}, {0, +1}, {-1, -1}, {+1, -1}, {-1, +1}, {+1, +1}};
-    static const int weights[] = {1000, 1000, 1000, 1000, 1414, 1414, 1414, 1414}; // M_SQRT2
+void World::updateObjects(float dt) {
+    m_updating.clear();
+    for (auto& object : m_objects) {
+        if (m_entities.checkUpdate(object->getEntity())) {
+            m_updating.push_back(object.get());
+        }
+    }
 
-    struct Node {
-        struct Compare {
-            inline const bool operator()(const Node* n1, const Node* n2) const {
-                return n1->actual + n1->heuristic > n2->actual + n2->heuristic;
-            }
-        };
-        using PrioQ = std::priority_queue<Node*, std::vector<Node*>, Compare>;
-
-        Node(): actual(std::numeric_limits<int>::max()) {}
-        Node* parent;
-        vec2i idx;
-        int   actual;
-        int   heuristic;
-    };
+    int slices = std::min<int>(m_update_workers.size() + 1, (m_updating.size() + UPDATE_GRAIN - 1) / UPDATE_GRAIN);
+    slices = std::max(slices, 1);
+    if ((int)m_slices.size() < slices) {
+        m_slices.resize(slices);
+        setPathBudget(m_pathfinder.getBudget());
+    }
 
-    std::unordered_map<vec2i, Node> m_nodes;
-    Node::PrioQ m_queue;
+    m_update_workers.parallelFor(slices, [this, dt, slices](int k) {
+        size_t begin = m_updating.size() * k / slices;
+        size_t end = m_updating.size() * (k + 1) / slices;
 
-    vec2i start = fstart.round<int>();
-    vec2i goal = fgoal.round<int>();
+        current_slice = &m_slices[k];
+        for (size_t i = begin; i < end; ++i) {
+            m_updating[i]->update(dt);
+        }
+        current_slice = nullptr;
+    });
 
-    Node* cur = &m_nodes[start];
-    cur->idx = start;
-    cur->parent = nullptr;
-    cur->actual = 0;
-    cur->heuristic = octile_heuristic(start - goal);
+    size_t spawned = m_objects.size();
+    for (int k = 0; k < slices; ++k) {
+        applySlice(m_slices[k]);
+    }
 
-    Node* best = cur;
+    // objects spawned by the updates get their first update right away
+    for (size_t i = spawned; i < m_objects.size(); ++i) {
+        Object& object = *m_objects[i];
 
-    m_queue.push(cur);
+        if (m_entities.checkUpdate(object.getEntity())) {
+            object.update(dt);
+        }
+    }
+}
 
-    while (!m_queue.empty() && m_queue.size() < 50) {
-        cur = m_queue.top();
+/**
+ * Apply changes queued by the objects of a slice
+ */
+void World::applySlice(UpdateSlice& slice) {
+    for (Command& command : slice.m_commands) {
+        switch (command.m_kind) {
+            case Command::SPAWN_SNOWBALL:
+                addSnowball(command.m_pos, command.m_dir, command.m_owner_id);
+                break;
+            case Command::SPAWN_LABEL:
+                addLabel(command.m_pos, command.m_text, command.m_size, command.m_value, command.m_ttl);
+                break;
+            case Command::SET_TYPE:
+                m_entities.setType(command.m_object->getEntity(), command.m_value);
+                break;
+        }
+    }
+    slice.m_commands.clear();
 
-        if (cur->idx == goal) {
-            best = cur;
-            break;
+    for (const vec2i& chunk_pos : slice.m_chunk_requests) {
+        if (m_chunks.find(chunk_pos) == nullptr) {
+            requestChunk(chunk_pos);
         }
-        // remember node closest to the goal in case we can't reach it
-        if ((cur->heuristic < best->heuristic) || ((cur->heuristic == best->heuristic) && (cur->actual < best->actual))) {
-            best = cur;
+    }
+    slice.m_chunk_requests.clear();
+
+    m_chunk_stats.m_hits += slice.m_chunk_hits;
+    m_chunk_stats.m_misses += slice.m_chunk_misses;
+    slice.m_chunk_hits = 0;
+    slice.m_chunk_misses = 0;
+}
+
+/**
+ * Path between tiles, waypoints in reverse order without the start.
+ * If the goal can't be reached within the budget the path leads to the closest tile found.
+ */
+bool World::buildPath(const vec2f& from, const vec2f& goal, std::vector<vec2f>& path) {
+    // one grid per thread, updates on workers search in parallel
+    Pathfinder& pathfinder = current_slice ? current_slice->m_pathfinder : m_pathfinder;
+
+    return pathfinder.find(from.round<int>(), goal.round<int>(), [this](const vec2i& pos) {
+        return isPassable(pos);
+    }, path);
+}
+
+/**
+ * Waypoints to walk through with buildPath, in reverse order, the goal first.
+ * Goals nearby or without a route over the resident chunks are the only waypoint.
+ */
+bool World::buildRoute(const vec2f& from, const vec2f& goal, std::vector<vec2f>& route) {
+    vec2i start = from.round<int>();
+    vec2i end = goal.round<int>();
+    vec2i start_chunk = getChunkPos(start);
+
+    // other chunks are resident depending on how fast the workers are,
+    // deterministic worlds only use those waited for around objects
+    auto graphs = [this, start_chunk](const vec2i& chunk_pos) -> const ChunkGraph* {
+        if (m_deterministic && (std::abs(chunk_pos.x - start_chunk.x) > Chunk::SIZE || std::abs(chunk_pos.y - start_chunk.y) > Chunk::SIZE)) {
+            return nullptr;
         }
-        m_queue.pop();
+        const Chunk* chunk = m_chunks.find(chunk_pos);
+        return chunk ? &chunk->m_graph : nullptr;
+    };
 
-        for (int i = 0; i < 8; ++i) {
-            vec2i idx = cur->idx + steps[i];
-            bool passable = isPassable(idx);
+    RoutePlanner& planner = current_slice ? current_slice->m_planner : m_planner;
 
-            // allow diagonal movement only if adjacent tiles are passable
-            if (i > 3) {
-                passable = passable && isPassable(cur->idx + vec2i(steps[i].x, 0));
-                passable = passable && isPassable(cur->idx + vec2i(0, steps[i].y));
-            }
+    if (std::max(std::abs(end.x - start.x), std::abs(end.y - start.y)) > ROUTE_DISTANCE &&
+        planner.find(start, end, graphs, route)) {
+        return true;
+    }
+    route.assign(1, goal);
+    return false;
+}
 
-            if (passable) {
-                Node* next = &m_nodes[idx];
-                int actual = cur->actual + weights[i];
+/**
+ * Limit nodes expanded by a path search
+ */
+void World::setPathBudget(unsigned nodes) {
+    m_pathfinder.setBudget(nodes);
+    for (auto& slice : m_slices) {
+        slice.m_pathfinder.setBudget(nodes);
+    }
+}
 
-                if (actual < next->actual) {
-                    next->idx = idx;
-                    next->parent = cur;
-                    next->actual = actual;
-                    next->heuristic = octile_heuristic(idx - goal);
+/**
+ * Path searches of all threads
+ */
+Pathfinder::Stats World::getPathStats() const {
+    Pathfinder::Stats stats = m_pathfinder.getStats();
 
-                    m_queue.push(next);
-                }
-            }
-        }
+    for (auto& slice : m_slices) {
+        stats.m_searches += slice.m_pathfinder.getStats().m_searches;
+        stats.m_expanded += slice.m_pathfinder.getStats().m_expanded;
+        stats.m_partial += slice.m_pathfinder.getStats().m_partial;
     }
+    return stats;
+}
+
+/**
+ * Route searches of all threads
+ */
+RoutePlanner::Stats World::getRouteStats() const {
+    RoutePlanner::Stats stats = m_planner.getStats();
 
-    std::vector<vec2f> path;
-    for (cur = best; cur && cur->idx != start; cur = cur->parent) {
-        path.push_back((vec2f)(cur->idx));
+    for (auto& slice : m_slices) {
+        stats.m_searches += slice.m_planner.getStats().m_searches;
+        stats.m_expanded += slice.m_planner.getStats().m_expanded;
+        stats.m_failed += slice.m_planner.getStats().m_failed;
     }
-    return path;
+    return stats;
 }
 
 /**
@@ -448,6 +1024,44 @@ bool World::checkVisible(const vec2f& forigin, const vec2f& ftarget) {
     return true;
 }
 
+/**
+ * Act for the player. Actions are recorded in world coordinates,
+ * screen coordinates depend on the view, which is interpolated.
+ */
+void World::playerAction(int action, const vec2f& pos) {
+    if (m_replay && m_replay->isRecording()) {
+        m_replay->write({m_frame, uint8_t(action), pos});
+    }
+
+    if (action == Replay::WALK) {
+        // actions come between updates, the player may have entered a chunk
+        // whose neighbours are not resident yet, the path must not depend on it
+        if (m_deterministic) {
+            waitChunksAround(getChunkPos(m_player->getPosition().round<int>()));
+        }
+        m_player->walkTo(pos);
+    }
+    else if (action == Replay::THROW) {
+        m_player->throwAt(pos);
+    }
+}
+
+void World::setDeterministic(bool deterministic) {
+    m_deterministic = deterministic;
+}
+
+void World::setReplay(std::unique_ptr<Replay> replay) {
+    m_replay = std::move(replay);
+}
+
+vec2f World::getChecksum() const {
+    vec2f sum;
+    for (auto& object : m_objects) {
+        sum += object->getPosition();
+    }
+    return sum;
+}
+
 /**
  * Handle user input for playing state
  */
@@ -455,16 +1069,21 @@ void World::onEvent(SDL_Event& ev) {
     if (ev.type == SDL_MOUSEMOTION) {
         m_cursor = vec2i(ev.motion.x, ev.motion.y);
     }
-    else if (ev.type == SDL_MOUSEBUTTONUP && ev.button.button == SDL_BUTTON_LEFT) {
-        m_player->walkTo(screenToWorld(vec2i(ev.button.x, ev.button.y)));
+    else if (ev.type == SDL_MOUSEBUTTONUP && ev.button.button == SDL_BUTTON_LEFT && !isPlayingBack()) {
+        playerAction(Replay::WALK, screenToWorld(vec2i(ev.button.x, ev.button.y)));
     }
-    else if (ev.type == SDL_MOUSEBUTTONUP && ev.button.button == SDL_BUTTON_RIGHT) {
-        m_player->throwAt(screenToWorld(vec2i(ev.button.x, ev.button.y)));
+    else if (ev.type == SDL_MOUSEBUTTONUP && ev.button.button == SDL_BUTTON_RIGHT && !isPlayingBack()) {
+        playerAction(Replay::THROW, screenToWorld(vec2i(ev.button.x, ev.button.y)));
     }
     else if (ev.type == SDL_KEYDOWN && ev.key.keysym.sym == SDLK_ESCAPE) {
         m_game.pushState(Game::STATE_MENU);
     }
     else if (ev.type == SDL_WINDOWEVENT && ev.window.event == SDL_WINDOWEVENT_RESIZED) {
         SDL_RenderGetLogicalSize(m_game.getRenderer(), &m_viewport.x, &m_viewport.y);
+        dropBlocks();
+    }
+    else if (ev.type == SDL_RENDER_TARGETS_RESET || ev.type == SDL_RENDER_DEVICE_RESET) {
+        // contents of render targets are lost
+        dropBlocks();
     }
 }
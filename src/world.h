@@ -17,69 +17,315 @@
 #ifndef WORLD_H
 #define WORLD_H
 
+#include <algorithm>
+#include <cmath>
 #include <memory>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include "state.h"
 #include "object.h"
 #include "vec.h"
 #include "sprite.h"
+#include "chunkmap.h"
+#include "chunkstore.h"
+#include "entities.h"
+#include "label.h"
+#include "objectpool.h"
+#include "pathfinder.h"
+#include "random.h"
+#include "renderqueue.h"
+#include "replay.h"
+#include "routeplanner.h"
+#include "snowball.h"
+#include "spatialgrid.h"
+#include "terrain.h"
+#include "worker.h"
 
+struct SDL_mutex;
+struct SDL_cond;
 class Character;
 class Object;
 
 class World: public State {
 public:
     World(Game&, int seed);
+    ~World();
 
-    void render(SDL_Renderer*);
+    void render(SDL_Renderer*, float alpha);
     void update(float dt);
     void onEvent(SDL_Event& ev);
 
     void add(std::unique_ptr<Object> object);
 
+    // short-lived objects come from pools
+    void addSnowball(const vec2f& pos, const vec2f& dir, int owner_id);
+    void addLabel(const vec2f& pos, const std::string& text, unsigned size, unsigned rgba, float ttl = 1);
+
+    // queries filter by type, so changes made by object updates apply after all of them
+    void setType(Object& object, unsigned type);
+
+    inline const ObjectPoolBase::Stats& getSnowballStats() const {
+        return m_snowballs.getStats();
+    }
+
+    inline const ObjectPoolBase::Stats& getLabelStats() const {
+        return m_labels.getStats();
+    }
+
     bool isPassable(const vec2i& pos);
 
-    std::vector<Object*> getObjectsInRadius(const vec2f& pos, float radius);
-    std::vector<vec2f> buildPath(const vec2f& from, const vec2f& goal);
+    // same seed and actions give the same game, chunks are waited for instead of skipped
+    void setDeterministic(bool deterministic);
+    // record player actions, or play them back and ignore the player
+    void setReplay(std::unique_ptr<Replay> replay);
+    // sums of object positions, a playback which differs from its recording goes its own way
+    vec2f getChecksum() const;
+
+    // objects fork their own streams from it when created
+    inline Random& getRandom() {
+        return m_random;
+    }
+
+    // chunk cache
+    struct ChunkStats {
+        unsigned long m_hits;
+        unsigned long m_misses;
+        unsigned long m_generations;
+        unsigned long m_evictions;
+        unsigned long m_loads; // from the chunk store
+        unsigned long m_saves; // to the chunk store
+    };
+    void setChunkBudget(size_t chunks);
+    void setChunkMemoryBudget(size_t bytes);
+
+    inline const ChunkStats& getChunkStats() const {
+        return m_chunk_stats;
+    }
+
+    // spatial queries, matches passing the filter are appended to the caller's storage
+    struct AnyObject {
+        inline bool operator()(const Object*) const {
+            return true;
+        }
+    };
+    template <typename Filter = AnyObject>
+    void queryRadius(const vec2f& pos, float radius, std::vector<Object*>& result, Filter filter = Filter()) const;
+    template <typename Filter = AnyObject>
+    void queryBox(const vec2f& lo, const vec2f& hi, std::vector<Object*>& result, Filter filter = Filter()) const;
+    template <typename Filter = AnyObject>
+    void queryNearest(const vec2f& pos, size_t k, float radius, std::vector<Object*>& result, Filter filter = Filter()) const;
+
+    bool buildPath(const vec2f& from, const vec2f& goal, std::vector<vec2f>& path);
+    bool buildRoute(const vec2f& from, const vec2f& goal, std::vector<vec2f>& route);
+    void setPathBudget(unsigned nodes);
+    Pathfinder::Stats getPathStats() const;
+    RoutePlanner::Stats getRouteStats() const;
     bool checkVisible(const vec2f& origin, const vec2f& target);
 
     inline Game& getGame() {
         return m_game;
     }
-private:
-    struct Tile {
-        enum  { LAYERS = 3 };
-        int m_layers[LAYERS];
-        int m_passable;
-    };
-    struct Chunk {
-        enum { SIZE = 64 };
-        Tile  m_tiles[SIZE][SIZE];
-        int   m_atime;
 
-        inline Chunk(): m_atime(0) {}
-    };
+    inline Entities& getEntities() {
+        return m_entities;
+    }
+private:
     const vec2i worldToScreen(const vec2f& pos) const;
     const vec2f screenToWorld(const vec2i& pos) const;
     void renderMarker(SDL_Renderer*, const vec2f& pos, unsigned rgba);
+    void moveObject(Object& object, const vec2f& pos);
+    void attach(ObjectPtr object);
+    void playerAction(int action, const vec2f& pos);
+
+    inline bool isPlayingBack() const {
+        return m_replay && !m_replay->isRecording();
+    }
+
+    // changes to the world made by object updates on workers, applied in object order later
+    struct Command {
+        enum Kind {SPAWN_SNOWBALL, SPAWN_LABEL, SET_TYPE};
+        Kind        m_kind;
+        Object*     m_object; // SET_TYPE
+        vec2f       m_pos;
+        vec2f       m_dir;
+        int         m_owner_id;
+        std::string m_text;
+        unsigned    m_size;
+        unsigned    m_value;  // rgba of labels, type for SET_TYPE
+        float       m_ttl;
+    };
+    // a contiguous run of the objects to update, done by one thread
+    struct UpdateSlice {
+        std::vector<Command> m_commands;
+        std::vector<vec2i>   m_chunk_requests;
+        ChunkMap::Cursor     m_chunk_cursor;
+        Pathfinder           m_pathfinder;
+        RoutePlanner         m_planner;
+        unsigned long        m_chunk_hits = 0;
+        unsigned long        m_chunk_misses = 0;
+    };
+    enum { UPDATE_GRAIN = 32 }; // min objects per slice, fewer are not worth a thread
+    void updateObjects(float dt);
+    void applySlice(UpdateSlice& slice);
+    Command& pushCommand(Command::Kind kind);
 
-    // procedural map generation
-    Tile& getTile(const vec2i&);
-    void  generate(Tile&, const vec2i&);
-    int   getVertexZ(const vec2i&);
-    int   getWallSpriteId(const vec2i&);
+    static thread_local UpdateSlice* current_slice; // set while a thread updates objects
 
-    int        m_seed;     
+    // objects further off screen are not drawn (pixels)
+    enum { CULL_MARGIN = 256 };
+
+    // waits for chunks in deterministic worlds (ms per try), a chunk still missing after all tries is an error
+    enum { CHUNK_WAIT = 1000, CHUNK_WAIT_TRIES = 10 };
+
+    // frames between checks written to recordings
+    enum { CHECK_INTERVAL = 60 };
+
+    // walks to goals further away (tiles) are routed over chunk graphs
+    enum { ROUTE_DISTANCE = 16 };
+
+    // objects touch when their squared distance is up to 0.5, rounded up
+    static constexpr float CONTACT_RADIUS = 0.7072f;
+
+    // chunk cache
+    static vec2i getChunkPos(const vec2i&);
+    Chunk* getChunk(const vec2i& chunk_pos);
+    void  requestChunk(const vec2i& chunk_pos);
+    void  saveChunk(const vec2i& chunk_pos, Chunk& chunk);
+    bool  waitChunk(const vec2i& chunk_pos, unsigned timeout);
+    void  prefetchChunks(const vec2f& pos);
+    void  collectChunks();
+    void  evictChunks();
+    void  waitObjectChunks();
+    void  waitChunksAround(const vec2i& chunk_pos);
+
+    // pre-rendered blocks of the flat tile layers
+    struct Block {
+        SDL_Texture* m_texture;
+        unsigned     m_atime;
+    };
+    enum { BLOCK_SIZE = 16, BLOCK_BUDGET = 24, BLOCK_LAYERS = 2 };
+    void renderBlocks(SDL_Renderer*);
+    SDL_Texture* getBlock(SDL_Renderer*, const vec2i& block_pos);
+    void dropBlocks(const vec2i& chunk_pos);
+    void dropBlocks();
+
+    // visible tiles in a ring buffer addressed by map coordinates modulo its size
+    struct TileRecord {
+        vec2i  m_pos;    // map coordinates of the resolved tile
+        vec2i  m_offset; // screen offset from the map origin
+        int8_t m_sprites[Tile::LAYERS];
+        bool   m_valid;
+    };
+    const TileRecord& getTileRecord(const vec2i& pos);
+
+    Terrain    m_terrain;
     vec2i      m_cursor;
     vec2i      m_viewport;
     vec2f      m_camera;
+    vec2f      m_lookahead; // where the camera is heading
+    vec2f      m_view;      // camera as drawn, between the last two updates
     Character* m_player;
+    unsigned   m_frame;
+    Random     m_random;
+    std::unique_ptr<Replay> m_replay;
+    bool       m_deterministic;
+
+    const Sprite* m_sprites; // tile sprites, indexed by tile layer values
+    Entities   m_entities; // data of m_objects, must outlive them
+    ObjectPool<Snowball> m_snowballs;
+    ObjectPool<Label> m_labels;
+    std::vector<ObjectPtr> m_objects;
+    std::vector<Object*> m_contacts; // collision candidates, reused between frames
+    std::vector<uint8_t> m_moved;    // entities moved by this frame's updates, by dense index
+    std::vector<Object*> m_updating; // objects to update this frame
+    std::vector<UpdateSlice> m_slices;
+    Pathfinder m_pathfinder; // searches made outside of object updates
+    RoutePlanner m_planner;
+    WorkerPool m_update_workers; // separate from m_workers, chunk generation would hold up frames
+    SpatialGrid m_grid;  // collision broadphase, cells fit the contact radius
+    SpatialGrid m_index; // coarse cells for spatial queries
+    RenderQueue m_render_queue;
+    ChunkMap   m_chunks;
+    ChunkMap::Cursor m_chunk_cursor;
+    ChunkStore m_store;
+    size_t     m_chunk_budget; // max resident chunks, 0 - unlimited
+    ChunkStats m_chunk_stats;
+
+    int        m_cached_layers; // layers below this are drawn from m_blocks
+    std::unordered_map<vec2i, Block> m_blocks;
 
-    std::vector<Sprite> m_sprites;
-    std::vector<std::unique_ptr<Object>> m_objects;
-    std::unordered_map<vec2i, Chunk> m_chunks;
+    std::vector<TileRecord> m_tile_window;
+    int        m_tile_window_bits; // log2 of the ring width and height
 
+    // chunks generated in background, published to m_chunks by collectChunks()
+    std::unordered_set<vec2i> m_requested;
+    std::vector<std::pair<vec2i, std::unique_ptr<Chunk>>> m_ready;
+    SDL_mutex* m_ready_lock;
+    SDL_cond*  m_ready_cond;
+    WorkerPool m_workers;
 };
 
+/**
+ * Objects closer than the radius
+ */
+template <typename Filter>
+void World::queryRadius(const vec2f& pos, float radius, std::vector<Object*>& result, Filter filter) const {
+    m_index.forEachNear(pos, radius, [&](Object* object) {
+        if ((pos - object->getPosition()).length() < radius && filter(object)) {
+            result.push_back(object);
+        }
+    });
+}
+
+/**
+ * Objects inside the box, borders included
+ */
+template <typename Filter>
+void World::queryBox(const vec2f& lo, const vec2f& hi, std::vector<Object*>& result, Filter filter) const {
+    m_index.forEachInBox(lo, hi, [&](Object* object) {
+        const vec2f& p = object->getPosition();
+
+        if (p.x >= lo.x && p.y >= lo.y && p.x <= hi.x && p.y <= hi.y && filter(object)) {
+            result.push_back(object);
+        }
+    });
+}
+
+/**
+ * Up to k objects closer than the radius, nearest first.
+ * Cells are searched in growing rings until no closer object can be found.
+ */
+template <typename Filter>
+void World::queryNearest(const vec2f& pos, size_t k, float radius, std::vector<Object*>& result, Filter filter) const {
+    size_t first = result.size();
+    vec2i center = m_index.getCell(pos);
+    int rings = (int)std::ceil(radius / m_index.getCellSize());
+
+    auto closer = [&pos](const Object* a, const Object* b) {
+        return (pos - a->getPosition()).squareLength() < (pos - b->getPosition()).squareLength();
+    };
+
+    for (int ring = 0; ring <= rings && k > 0; ++ring) {
+        m_index.forEachInRing(center, ring, [&](Object* object) {
+            if ((pos - object->getPosition()).length() < radius && filter(object)) {
+                result.push_back(object);
+            }
+        });
+
+        // keep the k nearest so far
+        if (result.size() - first > k) {
+            std::nth_element(result.begin() + first, result.begin() + first + k - 1, result.end(), closer);
+            result.resize(first + k);
+        }
+        // anything in the next ring is at least this far away
+        float reach = ring * m_index.getCellSize();
+        if (result.size() - first == k &&
+            (pos - (*std::max_element(result.begin() + first, result.end(), closer))->getPosition()).length() <= reach) {
+            break;
+        }
+    }
+    std::sort(result.begin() + first, result.end(), closer);
+}
+
 #endif